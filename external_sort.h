@@ -0,0 +1,395 @@
+// Copyright 2015 Kevin Melkowski
+
+#ifndef EXTERNAL_SORT_H_
+#define EXTERNAL_SORT_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "sort/radix_sort/radix_sort.h"
+
+// Memory ExternalSort uses by default, see set_memory_budget.
+const size_t kDefaultMemoryBudget = size_t(1) << 30;
+
+// Smallest block read from a run at a time while merging.  Bounds how many
+// runs are merged at once for a given memory budget.
+const size_t kMinMergeBlockBytes = 64 * 1024;
+
+// File descriptors left for the rest of the process when the open file limit
+// bounds how many runs are merged at once.
+const int kReservedDescriptors = 32;
+
+// Sorts raw binary files of T, in native byte order, that don't fit in
+// memory.  The input is read in chunks that fit the memory budget, each chunk
+// is radix sorted and spilled to the temp directory as a run, and the runs
+// are merged as many at a time as the budget allows.  Reading the next chunk
+// and writing the previous run overlap sorting the current chunk, and writing
+// merged output overlaps merging.  Files that fit in a single chunk are
+// sorted without spilling.
+template <typename T>
+class ExternalSort {
+ public:
+  explicit ExternalSort(const std::string& temp_directory);
+  ~ExternalSort();
+
+  // Sorts input into output, which may be the same file.  Returns false if a
+  // file can't be opened, read or written, the output is incomplete then, or
+  // if the input ends in part of a key.
+  bool SortFile(const std::string& input, const std::string& output);
+
+  // Bytes of keys held in memory at once, including the radix sort's scratch
+  // buffer and the merge blocks.
+  size_t memory_budget() const { return memory_budget_; }
+  void set_memory_budget(const size_t bytes) { memory_budget_ = bytes; }
+
+  // Sorter used for the runs.  Its order also orders the merge.
+  RadixSort* sorter() { return &sorter_; }
+
+  // Runs spilled and merge passes over them by the last SortFile.  A file
+  // sorted in one chunk has no runs.
+  int runs() const { return runs_; }
+  int merge_passes() const { return merge_passes_; }
+
+ private:
+  // Unsigned integer of the same width as T that orders like the sort.
+  typedef UnsignedBits<T> Key;
+
+  // Sequential reader over one run.
+  struct RunReader {
+    FILE* file;
+    T* block;
+    size_t position;
+    size_t count;
+  };
+
+  // Elements in a chunk, a quarter of the budget so the chunk being read, the
+  // chunk being sorted, the run being written and the sort's scratch buffer
+  // all fit.
+  size_t ChunkElements() const;
+
+  // Most runs merged at once, bounded by the memory budget and by the open
+  // file limit, since every run of a merge is open at the same time.
+  int MaxFanIn() const;
+
+  // Sorts input into runs, or straight into output if it fits in one chunk.
+  bool WriteRuns(FILE* input, const std::string& output,
+                 std::vector<std::string>* runs);
+
+  // Merge runs into output, the runs are removed as they are merged.
+  bool MergeRuns(const std::vector<std::string>& runs, FILE* output);
+
+  // Refill a reader's block, returns false at the end of the run.
+  bool Refill(RunReader* reader, const size_t block_elements);
+
+  // Create an empty run file in the temp directory.
+  bool NewRun(std::string* path, FILE** file);
+
+  // Remove spilled runs.
+  void RemoveRuns(std::vector<std::string>* runs);
+
+  Key OrderKey(const T value) const {
+    return OrderedBits(value, sorter_.order());
+  }
+
+  std::string temp_directory_;
+  size_t memory_budget_;
+  RadixSort sorter_;
+  int runs_;
+  int merge_passes_;
+  std::vector<std::string> spilled_;
+};
+
+template <typename T>
+ExternalSort<T>::ExternalSort(const std::string& temp_directory)
+    : temp_directory_(temp_directory),
+      memory_budget_(kDefaultMemoryBudget),
+      runs_(0),
+      merge_passes_(0) {
+  static_assert(std::is_arithmetic<T>::value && sizeof(T) <= 8,
+                "ExternalSort sorts integer and floating point keys");
+}
+
+template <typename T>
+ExternalSort<T>::~ExternalSort() {
+  RemoveRuns(&spilled_);
+}
+
+template <typename T>
+size_t ExternalSort<T>::ChunkElements() const {
+  const size_t elements = memory_budget_ / (4 * sizeof(T));
+  return std::max<size_t>(
+      1, std::min<size_t>(elements, std::numeric_limits<int>::max()));
+}
+
+template <typename T>
+int ExternalSort<T>::MaxFanIn() const {
+  // One block per run plus two for the output, which is double buffered.
+  const size_t blocks = memory_budget_ / kMinMergeBlockBytes;
+  size_t fan_in = blocks > 4 ? std::min<size_t>(blocks, 1 << 16) - 2 : 2;
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+      limit.rlim_cur != RLIM_INFINITY) {
+    const rlim_t files = limit.rlim_cur > kReservedDescriptors + 2
+                             ? limit.rlim_cur - kReservedDescriptors
+                             : 2;
+    fan_in = std::min<size_t>(fan_in, files);
+  }
+  return fan_in;
+}
+
+template <typename T>
+bool ExternalSort<T>::SortFile(const std::string& input,
+                               const std::string& output) {
+  runs_ = 0;
+  merge_passes_ = 0;
+  FILE* input_file = fopen(input.c_str(), "rb");
+  if (input_file == nullptr) {
+    return false;
+  }
+  // fread would silently drop a trailing partial key.
+  struct stat status;
+  if (fstat(fileno(input_file), &status) == 0 && S_ISREG(status.st_mode) &&
+      status.st_size % sizeof(T) != 0) {
+    fclose(input_file);
+    return false;
+  }
+  std::vector<std::string> runs;
+  const bool read = WriteRuns(input_file, output, &runs);
+  fclose(input_file);
+  // The merge blocks take the memory the sort's scratch buffer had.
+  sorter_.ReleaseScratch();
+  if (!read || runs.empty()) {
+    RemoveRuns(&spilled_);
+    return read;
+  }
+  runs_ = runs.size();
+
+  // Merge down to at most MaxFanIn runs, then into the output.
+  const int fan_in = MaxFanIn();
+  while (runs.size() > static_cast<size_t>(fan_in)) {
+    std::vector<std::string> merged;
+    for (size_t first = 0; first < runs.size(); first += fan_in) {
+      const size_t last = std::min(runs.size(), first + fan_in);
+      std::vector<std::string> group(runs.begin() + first,
+                                     runs.begin() + last);
+      std::string path;
+      FILE* file;
+      if (!NewRun(&path, &file)) {
+        RemoveRuns(&spilled_);
+        return false;
+      }
+      merged.push_back(path);
+      const bool written = MergeRuns(group, file);
+      if (fclose(file) != 0 || !written) {
+        RemoveRuns(&spilled_);
+        return false;
+      }
+    }
+    runs.swap(merged);
+    ++merge_passes_;
+  }
+  FILE* output_file = fopen(output.c_str(), "wb");
+  if (output_file == nullptr) {
+    RemoveRuns(&spilled_);
+    return false;
+  }
+  const bool written = MergeRuns(runs, output_file);
+  ++merge_passes_;
+  RemoveRuns(&spilled_);
+  return fclose(output_file) == 0 && written;
+}
+
+template <typename T>
+bool ExternalSort<T>::WriteRuns(FILE* input, const std::string& output,
+                                std::vector<std::string>* runs) {
+  const size_t chunk = ChunkElements();
+  std::vector<T> current(chunk);
+  std::vector<T> next(chunk);
+  std::vector<T> writing;
+  current.resize(fread(current.data(), sizeof(T), chunk, input));
+  if (ferror(input)) {
+    return false;
+  }
+  std::thread writer;
+  bool written = true;
+  bool first = true;
+  while (true) {
+    // Read the next chunk while this one is sorted and the previous run is
+    // written.
+    size_t next_count = 0;
+    std::thread reader;
+    if (current.size() == chunk) {
+      reader = std::thread([&next, &next_count, chunk, input]() {
+        next_count = fread(next.data(), sizeof(T), chunk, input);
+      });
+    }
+    if (!current.empty()) {
+      sorter_.Sort(current);
+    }
+    if (reader.joinable()) {
+      reader.join();
+    }
+    if (writer.joinable()) {
+      writer.join();
+    }
+    if (ferror(input) || !written) {
+      return false;
+    }
+
+    // A file that fits in one chunk goes straight to the output.
+    if (first && next_count == 0) {
+      FILE* file = fopen(output.c_str(), "wb");
+      if (file == nullptr) {
+        return false;
+      }
+      written = fwrite(current.data(), sizeof(T), current.size(), file) ==
+                current.size();
+      return fclose(file) == 0 && written;
+    }
+    first = false;
+
+    // Write this run in the background while the next chunk is sorted.
+    std::string path;
+    FILE* file;
+    if (!NewRun(&path, &file)) {
+      return false;
+    }
+    runs->push_back(path);
+    current.swap(writing);
+    writer = std::thread([&writing, &written, file]() {
+      written = fwrite(writing.data(), sizeof(T), writing.size(), file) ==
+                writing.size();
+      written = fclose(file) == 0 && written;
+    });
+    if (next_count == 0) {
+      writer.join();
+      return written;
+    }
+    next.resize(next_count);
+    current.swap(next);
+    next.resize(chunk);
+  }
+}
+
+template <typename T>
+bool ExternalSort<T>::MergeRuns(const std::vector<std::string>& runs,
+                                FILE* output) {
+  // The budget is split into equal blocks, one per run and two for output.
+  const size_t block_elements = std::max<size_t>(
+      kMinMergeBlockBytes / sizeof(T),
+      memory_budget_ / ((runs.size() + 2) * sizeof(T)));
+  std::vector<T> blocks(block_elements * runs.size());
+  std::vector<T> out(block_elements);
+  std::vector<T> flushing(block_elements);
+  std::vector<RunReader> readers(runs.size());
+  bool ok = true;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    readers[i].file = fopen(runs[i].c_str(), "rb");
+    readers[i].block = blocks.data() + i * block_elements;
+    readers[i].position = 0;
+    readers[i].count = 0;
+    ok = ok && readers[i].file != nullptr;
+  }
+
+  // Min heap of (key, run) pairs, ties go to the earlier run so equal keys
+  // keep their input order.
+  std::vector<std::pair<Key, int>> heap;
+  for (size_t i = 0; ok && i < readers.size(); ++i) {
+    if (Refill(&readers[i], block_elements)) {
+      heap.emplace_back(OrderKey(readers[i].block[0]), i);
+    }
+  }
+  auto greater = [](const std::pair<Key, int>& a,
+                    const std::pair<Key, int>& b) { return a > b; };
+  std::make_heap(heap.begin(), heap.end(), greater);
+
+  size_t filled = 0;
+  std::thread writer;
+  bool written = true;
+  while (ok && !heap.empty()) {
+    RunReader* reader = &readers[heap.front().second];
+    out[filled++] = reader->block[reader->position++];
+    if (filled == block_elements) {
+      // Write this block in the background while the next one is merged.
+      if (writer.joinable()) {
+        writer.join();
+      }
+      out.swap(flushing);
+      writer = std::thread([&flushing, &written, filled, output]() {
+        written = written &&
+                  fwrite(flushing.data(), sizeof(T), filled, output) == filled;
+      });
+      filled = 0;
+    }
+
+    // Replace the top with the run's next key and sift it down.
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    if (reader->position < reader->count ||
+        Refill(reader, block_elements)) {
+      heap.back().first = OrderKey(reader->block[reader->position]);
+      std::push_heap(heap.begin(), heap.end(), greater);
+    } else {
+      heap.pop_back();
+    }
+    ok = !ferror(reader->file);
+  }
+  if (writer.joinable()) {
+    writer.join();
+  }
+  written = written && fwrite(out.data(), sizeof(T), filled, output) == filled;
+  for (size_t i = 0; i < readers.size(); ++i) {
+    if (readers[i].file != nullptr) {
+      fclose(readers[i].file);
+    }
+    remove(runs[i].c_str());
+  }
+  return ok && written;
+}
+
+template <typename T>
+bool ExternalSort<T>::Refill(RunReader* reader, const size_t block_elements) {
+  reader->position = 0;
+  reader->count = fread(reader->block, sizeof(T), block_elements, reader->file);
+  return reader->count > 0;
+}
+
+template <typename T>
+bool ExternalSort<T>::NewRun(std::string* path, FILE** file) {
+  std::string name = temp_directory_ + "/radix_sort_run_XXXXXX";
+  const int descriptor = mkstemp(&name[0]);
+  if (descriptor < 0) {
+    return false;
+  }
+  *file = fdopen(descriptor, "wb");
+  if (*file == nullptr) {
+    close(descriptor);
+    remove(name.c_str());
+    return false;
+  }
+  *path = name;
+  spilled_.push_back(name);
+  return true;
+}
+
+template <typename T>
+void ExternalSort<T>::RemoveRuns(std::vector<std::string>* runs) {
+  for (size_t i = 0; i < runs->size(); ++i) {
+    remove((*runs)[i].c_str());
+  }
+  runs->clear();
+}
+
+#endif  // EXTERNAL_SORT_H_
@@ -0,0 +1,113 @@
+// Copyright 2015 Kevin Melkowski
+//
+// Sorts a raw binary file of keys in native byte order that may be larger
+// than memory, or in place through a mapping when it fits.
+//
+//   external_sort --type=uint64 --memory_mb=1024 --temp_dir=/tmp in out
+//   external_sort --type=double --mmap --huge_pages keys
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "sort/radix_sort/external_sort.h"
+#include "sort/radix_sort/mapped_sort.h"
+
+namespace {
+
+struct Options {
+  std::string type = "uint64";
+  size_t memory_mb = kDefaultMemoryBudget >> 20;
+  std::string temp_dir = "/tmp";
+  bool descending = false;
+  bool mmap = false;
+  bool huge_pages = false;
+};
+
+template <typename T>
+int SortFile(const Options& options, const char* input, const char* output) {
+  if (options.mmap) {
+    MappedSort<T> sorter;
+    sorter.set_huge_pages(options.huge_pages);
+    if (options.descending) {
+      sorter.sorter()->set_order(DESCENDING);
+    }
+    if (!sorter.SortFile(input)) {
+      fprintf(stderr, "external_sort: failed to sort %s in place\n", input);
+      return 1;
+    }
+    return 0;
+  }
+  ExternalSort<T> sorter(options.temp_dir);
+  sorter.set_memory_budget(options.memory_mb << 20);
+  if (options.descending) {
+    sorter.sorter()->set_order(DESCENDING);
+  }
+  if (!sorter.SortFile(input, output)) {
+    fprintf(stderr, "external_sort: failed to sort %s into %s\n", input,
+            output);
+    return 1;
+  }
+  return 0;
+}
+
+int Usage() {
+  fprintf(stderr,
+          "usage: external_sort [--type=uint64] [--memory_mb=N] "
+          "[--temp_dir=DIR] [--descending] input output\n"
+          "       external_sort [--type=uint64] --mmap [--huge_pages] "
+          "[--descending] file\n"
+          "  types: int8 int16 int32 int64 uint8 uint16 uint32 uint64 "
+          "float double\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  const char* files[2];
+  int num_files = 0;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--type=", 7) == 0) {
+      options.type = arg + 7;
+    } else if (strncmp(arg, "--memory_mb=", 12) == 0) {
+      options.memory_mb = strtoull(arg + 12, nullptr, 10);
+    } else if (strncmp(arg, "--temp_dir=", 11) == 0) {
+      options.temp_dir = arg + 11;
+    } else if (strcmp(arg, "--descending") == 0) {
+      options.descending = true;
+    } else if (strcmp(arg, "--mmap") == 0) {
+      options.mmap = true;
+    } else if (strcmp(arg, "--huge_pages") == 0) {
+      options.huge_pages = true;
+    } else if (arg[0] != '-' && num_files < 2) {
+      files[num_files++] = arg;
+    } else {
+      return Usage();
+    }
+  }
+  if (num_files != (options.mmap ? 1 : 2) || options.memory_mb == 0) {
+    return Usage();
+  }
+  if (options.mmap) {
+    files[1] = files[0];
+  }
+
+  const std::string& type = options.type;
+  if (type == "int8") return SortFile<int8_t>(options, files[0], files[1]);
+  if (type == "int16") return SortFile<int16_t>(options, files[0], files[1]);
+  if (type == "int32") return SortFile<int32_t>(options, files[0], files[1]);
+  if (type == "int64") return SortFile<int64_t>(options, files[0], files[1]);
+  if (type == "uint8") return SortFile<uint8_t>(options, files[0], files[1]);
+  if (type == "uint16") return SortFile<uint16_t>(options, files[0], files[1]);
+  if (type == "uint32") return SortFile<uint32_t>(options, files[0], files[1]);
+  if (type == "uint64") return SortFile<uint64_t>(options, files[0], files[1]);
+  if (type == "float") return SortFile<float>(options, files[0], files[1]);
+  if (type == "double") return SortFile<double>(options, files[0], files[1]);
+  return Usage();
+}
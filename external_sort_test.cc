@@ -0,0 +1,248 @@
+// Copyright 2015 Kevin Melkowski
+
+#include "sort/radix_sort/external_sort.h"
+
+#include <glob.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class ExternalSortTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    const char* directory = getenv("TEST_TMPDIR");
+    directory_ = directory != nullptr ? directory : "/tmp";
+    input_ = directory_ + "/external_sort_test_input";
+    output_ = directory_ + "/external_sort_test_output";
+  }
+  virtual void TearDown() {
+    remove(input_.c_str());
+    remove(output_.c_str());
+  }
+
+  template <typename T>
+  void WriteFile(const std::string& path, const std::vector<T>& values) {
+    FILE* file = fopen(path.c_str(), "wb");
+    ASSERT_NE(nullptr, file);
+    if (!values.empty()) {  // data() may be null for an empty vector.
+      EXPECT_EQ(values.size(),
+                fwrite(values.data(), sizeof(T), values.size(), file));
+    }
+    fclose(file);
+  }
+
+  template <typename T>
+  std::vector<T> ReadFile(const std::string& path) {
+    std::vector<T> values;
+    FILE* file = fopen(path.c_str(), "rb");
+    EXPECT_NE(nullptr, file);
+    if (file == nullptr) {
+      return values;
+    }
+    T value;
+    while (fread(&value, sizeof(T), 1, file) == 1) {
+      values.push_back(value);
+    }
+    fclose(file);
+    return values;
+  }
+
+  // Number of runs left in the temp directory.
+  int LeftoverRuns() {
+    glob_t runs;
+    const std::string pattern = directory_ + "/radix_sort_run_*";
+    if (glob(pattern.c_str(), 0, nullptr, &runs) != 0) {
+      return 0;
+    }
+    const int count = runs.gl_pathc;
+    globfree(&runs);
+    return count;
+  }
+
+  std::string directory_;
+  std::string input_;
+  std::string output_;
+};
+
+TEST_F(ExternalSortTest, TestFitsInMemory) {
+  // Tests that a file smaller than a chunk is sorted without spilling runs.
+  std::vector<uint64_t> values({13, 255, 1, 11, 137, 113});
+  WriteFile(input_, values);
+  ExternalSort<uint64_t> sorter(directory_);
+  EXPECT_TRUE(sorter.SortFile(input_, output_));
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, ReadFile<uint64_t>(output_));
+  EXPECT_EQ(0, sorter.runs());
+  EXPECT_EQ(0, sorter.merge_passes());
+}
+
+TEST_F(ExternalSortTest, TestEmptyFile) {
+  // Tests that an empty file sorts to an empty file.
+  WriteFile(input_, std::vector<uint32_t>());
+  ExternalSort<uint32_t> sorter(directory_);
+  EXPECT_TRUE(sorter.SortFile(input_, output_));
+  EXPECT_TRUE(ReadFile<uint32_t>(output_).empty());
+}
+
+TEST_F(ExternalSortTest, TestMissingInput) {
+  // Tests that a missing input file is reported.
+  ExternalSort<uint64_t> sorter(directory_);
+  EXPECT_FALSE(sorter.SortFile(directory_ + "/no_such_file", output_));
+}
+
+TEST_F(ExternalSortTest, TestPartialKey) {
+  // Tests that an input ending in part of a key is reported.
+  WriteFile(input_, std::vector<uint8_t>({1, 2, 3, 4, 5, 6}));
+  ExternalSort<uint32_t> sorter(directory_);
+  EXPECT_FALSE(sorter.SortFile(input_, output_));
+}
+
+TEST_F(ExternalSortTest, TestManyRuns) {
+  // Tests that a small budget spills many runs and merges them in several
+  // passes, leaving no runs behind.
+  std::mt19937_64 generator(17);
+  std::vector<uint64_t> values(100000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = generator();
+  }
+  WriteFile(input_, values);
+  ExternalSort<uint64_t> sorter(directory_);
+  sorter.set_memory_budget(4 * kMinMergeBlockBytes);
+  EXPECT_TRUE(sorter.SortFile(input_, output_));
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, ReadFile<uint64_t>(output_));
+  EXPECT_EQ(13, sorter.runs());
+  EXPECT_LT(1, sorter.merge_passes());
+  EXPECT_EQ(0, LeftoverRuns());
+}
+
+TEST_F(ExternalSortTest, TestBudgetBelowTwoBlocks) {
+  // Tests that a budget too small for two merge blocks still merges two runs
+  // at a time.
+  std::mt19937 generator(17);
+  std::vector<uint32_t> values(20000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = generator();
+  }
+  WriteFile(input_, values);
+  ExternalSort<uint32_t> sorter(directory_);
+  sorter.set_memory_budget(kMinMergeBlockBytes);
+  EXPECT_TRUE(sorter.SortFile(input_, output_));
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, ReadFile<uint32_t>(output_));
+  EXPECT_EQ(5, sorter.runs());
+  EXPECT_EQ(3, sorter.merge_passes());
+  EXPECT_EQ(0, LeftoverRuns());
+}
+
+TEST_F(ExternalSortTest, TestOpenFileLimit) {
+  // Tests that the open file limit caps how many runs are merged at once
+  // below what the budget allows, adding merge passes instead of failing.
+  std::mt19937 generator(17);
+  const size_t budget = 16 * kMinMergeBlockBytes;
+  std::vector<uint32_t> values(10 * (budget / (4 * sizeof(uint32_t))));
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = generator();
+  }
+  WriteFile(input_, values);
+  rlimit original;
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &original));
+  rlimit lowered = original;
+  lowered.rlim_cur = kReservedDescriptors + 4;
+  ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &lowered));
+  ExternalSort<uint32_t> sorter(directory_);
+  sorter.set_memory_budget(budget);
+  const bool sorted = sorter.SortFile(input_, output_);
+  setrlimit(RLIMIT_NOFILE, &original);
+  EXPECT_TRUE(sorted);
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, ReadFile<uint32_t>(output_));
+  EXPECT_EQ(10, sorter.runs());
+  EXPECT_EQ(2, sorter.merge_passes());
+  EXPECT_EQ(0, LeftoverRuns());
+}
+
+TEST_F(ExternalSortTest, TestExactChunks) {
+  // Tests inputs that end exactly on a chunk boundary.
+  const size_t budget = 4 * kMinMergeBlockBytes;
+  const size_t chunk = budget / (4 * sizeof(uint32_t));
+  for (size_t size : {chunk, 3 * chunk}) {
+    std::vector<uint32_t> values(size);
+    for (size_t i = 0; i < size; ++i) {
+      values[i] = static_cast<uint32_t>(size - i);
+    }
+    WriteFile(input_, values);
+    ExternalSort<uint32_t> sorter(directory_);
+    sorter.set_memory_budget(budget);
+    EXPECT_TRUE(sorter.SortFile(input_, output_));
+    std::sort(values.begin(), values.end());
+    EXPECT_EQ(values, ReadFile<uint32_t>(output_));
+    EXPECT_EQ(size == chunk ? 0 : 3, sorter.runs());
+  }
+}
+
+TEST_F(ExternalSortTest, TestDoublesInPlace) {
+  // Tests merging negative doubles, signed zeros and infinities back into
+  // the input file.
+  std::mt19937_64 generator(3);
+  std::uniform_real_distribution<double> distribution(-1e6, 1e6);
+  std::vector<double> values(50000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = distribution(generator);
+  }
+  values[10] = -0.0;
+  values[20] = 0.0;
+  values[30] = std::numeric_limits<double>::infinity();
+  values[40] = -std::numeric_limits<double>::infinity();
+  WriteFile(input_, values);
+  ExternalSort<double> sorter(directory_);
+  sorter.set_memory_budget(4 * kMinMergeBlockBytes);
+  EXPECT_TRUE(sorter.SortFile(input_, input_));
+  std::vector<double> sorted = ReadFile<double>(input_);
+  ASSERT_EQ(values.size(), sorted.size());
+  EXPECT_TRUE(std::is_sorted(sorted.begin(), sorted.end()));
+  EXPECT_TRUE(std::signbit(sorted[std::lower_bound(sorted.begin(),
+                                                   sorted.end(), 0.0) -
+                                  sorted.begin()]));
+  std::sort(values.begin(), values.end());
+  EXPECT_TRUE(std::equal(values.begin(), values.end(), sorted.begin()));
+}
+
+TEST_F(ExternalSortTest, TestDescendingSigned) {
+  // Tests that the merge follows the sorter's order.
+  std::mt19937 generator(5);
+  std::vector<int32_t> values(60000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<int32_t>(generator());
+  }
+  WriteFile(input_, values);
+  ExternalSort<int32_t> sorter(directory_);
+  sorter.set_memory_budget(4 * kMinMergeBlockBytes);
+  sorter.sorter()->set_order(DESCENDING);
+  EXPECT_TRUE(sorter.SortFile(input_, output_));
+  EXPECT_LT(1, sorter.runs());
+  std::sort(values.rbegin(), values.rend());
+  EXPECT_EQ(values, ReadFile<int32_t>(output_));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  return RUN_ALL_TESTS();
+}
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <random>
 #include <vector>
 
 #include "glog/logging.h"
@@ -81,6 +82,17 @@ TEST_F(HistogramTest, TestFlipFlopForIntegers32Bit) {
   EXPECT_EQ(0x8000FFFF, flip_flop_positive_value);
 }
 
+TEST_F(HistogramTest, TestFlipFlopForIntegers128Bit) {
+  // Tests similar to 32 Bit test but with 128 Bit values.
+  const unsigned __int128 sign_bit = static_cast<unsigned __int128>(1) << 127;
+  const unsigned __int128 negative = sign_bit | 0xFFFF;
+  const unsigned __int128 zero = 0;
+  const unsigned __int128 positive = 0xFFFF;
+  EXPECT_TRUE(positive == hist_->FlipFlopInteger(negative));
+  EXPECT_TRUE(sign_bit == hist_->FlipFlopInteger(zero));
+  EXPECT_TRUE((sign_bit | 0xFFFF) == hist_->FlipFlopInteger(positive));
+}
+
 TEST_F(HistogramTest, TestFlipForFloatingPointValues32Bit) {
   // Tests that negative value will be between [0.0.0.0, 127.255.255.255] when
   // flipped.
@@ -396,6 +408,164 @@ TEST_F(HistogramTest, TestGetHistogramFor64BitArrayFloat) {
   EXPECT_EQ(expected, output);
 }
 
+TEST_F(HistogramTest, TestIsTrivialDigit) {
+  // Tests that a digit is trivial only when one bucket holds every element.
+  std::vector<uint64_t> input({0x7FF, 0x12345, 0x7FF, 0x22345});
+  std::vector<std::vector<uint64_t>> output =
+      hist_->GetHistogram(&input[0], input.size(), UNSIGNED);
+  EXPECT_FALSE(hist_->IsTrivialDigit(output[0], input.size()));
+  EXPECT_FALSE(hist_->IsTrivialDigit(output[1], input.size()));
+  EXPECT_TRUE(hist_->IsTrivialDigit(output[2], input.size()));
+  EXPECT_TRUE(hist_->IsTrivialDigit(output[5], input.size()));
+}
+
+TEST_F(HistogramTest, TestIsTrivialDigitEmpty) {
+  // Tests that every digit of an empty array is trivial.
+  std::vector<uint32_t> input;
+  std::vector<std::vector<uint64_t>> output =
+      hist_->GetHistogram(&input[0], input.size(), UNSIGNED);
+  EXPECT_TRUE(hist_->IsTrivialDigit(output[0], input.size()));
+}
+
+TEST_F(HistogramTest, TestSetSimdLevel) {
+  // Tests that the level defaults to SCALAR and never exceeds the supported
+  // one.
+  EXPECT_EQ(SCALAR, hist_->simd_level());
+  hist_->set_simd_level(AVX2);
+  EXPECT_EQ(Histogram::SupportedSimdLevel(), hist_->simd_level());
+  hist_->set_simd_level(SCALAR);
+  EXPECT_EQ(SCALAR, hist_->simd_level());
+}
+
+TEST_F(HistogramTest, TestSimdHistogramsMatchScalar32Bit) {
+  // Tests that every supported instruction set flips the array and counts
+  // exactly like the scalar loops, including the tails.
+  std::mt19937 generator(13);
+  Histogram scalar;
+  scalar.set_simd_level(SCALAR);
+  for (const int size : {1, 7, 8, 15, 16, 17, 33, 10007}) {
+    std::vector<uint32_t> input(size);
+    for (int i = 0; i < size; ++i) {  // Repeated digits and random ones.
+      input[i] = i % 3 == 0 ? 0x80000000 : generator();
+    }
+    for (const SortType type : {UNSIGNED, SIGNED, FLOAT}) {
+      for (const SimdLevel level : {SCALAR, AVX2}) {
+        std::vector<uint32_t> expected_array(input);
+        std::vector<uint64_t> expected(3 * 2048);
+        scalar.GetHistogram(&expected_array[0], size, type, &expected[0]);
+        hist_->set_simd_level(level);
+        std::vector<uint32_t> output_array(input);
+        std::vector<uint64_t> output(3 * 2048);
+        hist_->GetHistogram(&output_array[0], size, type, &output[0]);
+        EXPECT_EQ(expected_array, output_array);
+        EXPECT_EQ(expected, output);
+      }
+    }
+  }
+}
+
+TEST_F(HistogramTest, TestSimdHistogramsMatchScalar64Bit) {
+  // Tests the 64-bit histograms like the 32-bit ones.
+  std::mt19937_64 generator(13);
+  Histogram scalar;
+  scalar.set_simd_level(SCALAR);
+  for (const int size : {1, 3, 4, 7, 8, 9, 33, 10007}) {
+    std::vector<uint64_t> input(size);
+    for (int i = 0; i < size; ++i) {  // Repeated digits and random ones.
+      input[i] = i % 3 == 0 ? 0x8000000000000001 : generator();
+    }
+    for (const SortType type : {UNSIGNED, SIGNED, FLOAT}) {
+      for (const SimdLevel level : {SCALAR, AVX2}) {
+        std::vector<uint64_t> expected_array(input);
+        std::vector<uint64_t> expected(6 * 2048);
+        scalar.GetHistogram(&expected_array[0], size, type, &expected[0]);
+        hist_->set_simd_level(level);
+        std::vector<uint64_t> output_array(input);
+        std::vector<uint64_t> output(6 * 2048);
+        hist_->GetHistogram(&output_array[0], size, type, &output[0]);
+        EXPECT_EQ(expected_array, output_array);
+        EXPECT_EQ(expected, output);
+      }
+    }
+  }
+}
+
+TEST_F(HistogramTest, TestDigitPasses) {
+  // Tests the pass counts of every digit width.
+  EXPECT_EQ(4, (DigitPasses<8, uint32_t>()));
+  EXPECT_EQ(3, (DigitPasses<11, uint32_t>()));
+  EXPECT_EQ(2, (DigitPasses<16, uint32_t>()));
+  EXPECT_EQ(8, (DigitPasses<8, uint64_t>()));
+  EXPECT_EQ(6, (DigitPasses<11, uint64_t>()));
+  EXPECT_EQ(4, (DigitPasses<16, uint64_t>()));
+}
+
+TEST_F(HistogramTest, TestDigitHistogram8Bit) {
+  // Tests the 8-bit digit histograms of signed values, flipped in place.
+  std::vector<uint32_t> input({0x01020304, 0x81020305, 0x7F020304});
+  std::vector<uint32_t> flipped({0x81020304, 0x01020305, 0xFF020304});
+  std::vector<uint64_t> output(4 * 256);
+  hist_->GetDigitHistogram<8>(&input[0], input.size(), SIGNED, &output[0]);
+  EXPECT_EQ(flipped, input);
+  EXPECT_EQ(0, output[0x03]);
+  EXPECT_EQ(2, output[0x04]);
+  EXPECT_EQ(3, output[0x05]);
+  EXPECT_EQ(0, output[256 + 0x02]);
+  EXPECT_EQ(3, output[256 + 0x03]);
+  EXPECT_EQ(3, output[2 * 256 + 0x02]);
+  EXPECT_EQ(1, output[3 * 256 + 0x01]);
+  EXPECT_EQ(2, output[3 * 256 + 0x81]);
+  EXPECT_EQ(3, output[3 * 256 + 0xFF]);
+}
+
+TEST_F(HistogramTest, TestDigitHistogramsMatchGetHistogram) {
+  // Tests that 11-bit digit histograms are GetHistogram's and that 16-bit
+  // ones cover every value once per pass.
+  std::mt19937_64 generator(13);
+  std::vector<uint64_t> input(1000);
+  for (auto &value : input) {
+    value = generator();
+  }
+  std::vector<uint64_t> expected_array(input);
+  std::vector<uint64_t> expected(6 * 2048);
+  hist_->GetHistogram(&expected_array[0], input.size(), FLOAT, &expected[0]);
+  std::vector<uint64_t> output_array(input);
+  std::vector<uint64_t> output(6 * 2048);
+  hist_->GetDigitHistogram<11>(&output_array[0], input.size(), FLOAT,
+                               &output[0]);
+  EXPECT_EQ(expected_array, output_array);
+  EXPECT_EQ(expected, output);
+  std::vector<uint64_t> wide(4 * 65536);
+  hist_->GetDigitHistogram<16>(&input[0], input.size(), UNSIGNED, &wide[0]);
+  for (int pass = 0; pass < 4; ++pass) {
+    EXPECT_EQ(input.size(), wide[pass * 65536 + 65535]);
+  }
+}
+
+TEST_F(HistogramTest, TestCopyingDigitHistogram) {
+  // Tests that counting into a copy leaves the input alone and gives the
+  // same flipped keys and histograms as flipping in place.
+  std::mt19937_64 generator(13);
+  std::vector<uint32_t> input(1000);
+  for (auto &value : input) {
+    value = generator();
+  }
+  for (const SortType type : {UNSIGNED, SIGNED, FLOAT}) {
+    std::vector<uint32_t> expected_array(input);
+    std::vector<uint64_t> expected(3 * 2048);
+    hist_->GetDigitHistogram<11>(&expected_array[0], input.size(), type,
+                                 &expected[0]);
+    const std::vector<uint32_t> original(input);
+    std::vector<uint32_t> flipped(input.size());
+    std::vector<uint64_t> output(3 * 2048);
+    hist_->GetDigitHistogram<11>(&input[0], &flipped[0], input.size(), type,
+                                 &output[0]);
+    EXPECT_EQ(original, input);
+    EXPECT_EQ(expected_array, flipped);
+    EXPECT_EQ(expected, output);
+  }
+}
+
 }  // namespace
 
 int main(int argc, char *argv[]) {
@@ -0,0 +1,86 @@
+// Copyright 2015 Kevin Melkowski
+
+#ifndef MAPPED_SORT_H_
+#define MAPPED_SORT_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <limits>
+#include <string>
+#include <type_traits>
+
+#include "sort/radix_sort/radix_sort.h"
+
+// Sorts a raw binary file of T, in native byte order, in place through a
+// shared mapping.  The sort works on the mapped pages directly, so there is
+// no read into a buffer and no write back out, and peak memory is the file
+// plus the sorter's scratch buffer, or just the file with IN_PLACE_MSD.
+// The file has to fit in memory, larger ones belong to ExternalSort.
+template <typename T>
+class MappedSort {
+ public:
+  MappedSort() : huge_pages_(false) {
+    static_assert(std::is_arithmetic<T>::value && sizeof(T) <= 8,
+                  "MappedSort sorts integer and floating point keys");
+  }
+
+  // Sorts the file and syncs it back to disk.  Returns false if it can't be
+  // opened or mapped, isn't a whole number of keys, holds more than INT_MAX
+  // keys or fails to sync.
+  bool SortFile(const std::string& path);
+
+  // Ask for transparent huge pages on the mapping, which cuts TLB misses
+  // where the file system supports them.  Only a hint.
+  bool huge_pages() const { return huge_pages_; }
+  void set_huge_pages(const bool huge_pages) { huge_pages_ = huge_pages; }
+
+  // Sorter used on the mapping.
+  RadixSort* sorter() { return &sorter_; }
+
+ private:
+  RadixSort sorter_;
+  bool huge_pages_;
+};
+
+template <typename T>
+bool MappedSort<T>::SortFile(const std::string& path) {
+  const int descriptor = open(path.c_str(), O_RDWR);
+  if (descriptor < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(descriptor, &status) != 0 || status.st_size % sizeof(T) != 0 ||
+      status.st_size / sizeof(T) >
+          static_cast<size_t>(std::numeric_limits<int>::max())) {
+    close(descriptor);
+    return false;
+  }
+  const size_t bytes = status.st_size;
+  if (bytes == 0) {  // Nothing to map.
+    close(descriptor);
+    return true;
+  }
+  void* mapping =
+      mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+  close(descriptor);  // The mapping keeps the file open.
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  // Every pass touches the whole file, so fault it all in up front.  The
+  // hints are best effort and their failures are ignored.
+  madvise(mapping, bytes, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+  if (huge_pages_) {
+    madvise(mapping, bytes, MADV_HUGEPAGE);
+  }
+#endif
+  sorter_.Sort(static_cast<T*>(mapping), bytes / sizeof(T));
+  const bool synced = msync(mapping, bytes, MS_SYNC) == 0;
+  return munmap(mapping, bytes) == 0 && synced;
+}
+
+#endif  // MAPPED_SORT_H_
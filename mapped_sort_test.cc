@@ -0,0 +1,116 @@
+// Copyright 2015 Kevin Melkowski
+
+#include "sort/radix_sort/mapped_sort.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class MappedSortTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    const char* directory = getenv("TEST_TMPDIR");
+    path_ = std::string(directory != nullptr ? directory : "/tmp") +
+            "/mapped_sort_test_keys";
+  }
+  virtual void TearDown() { remove(path_.c_str()); }
+
+  template <typename T>
+  void WriteFile(const std::vector<T>& values) {
+    FILE* file = fopen(path_.c_str(), "wb");
+    ASSERT_NE(nullptr, file);
+    if (!values.empty()) {  // data() may be null for an empty vector.
+      EXPECT_EQ(values.size(),
+                fwrite(values.data(), sizeof(T), values.size(), file));
+    }
+    fclose(file);
+  }
+
+  template <typename T>
+  std::vector<T> ReadFile() {
+    std::vector<T> values;
+    FILE* file = fopen(path_.c_str(), "rb");
+    EXPECT_NE(nullptr, file);
+    if (file == nullptr) {
+      return values;
+    }
+    T value;
+    while (fread(&value, sizeof(T), 1, file) == 1) {
+      values.push_back(value);
+    }
+    fclose(file);
+    return values;
+  }
+
+  std::string path_;
+};
+
+TEST_F(MappedSortTest, TestSortsInPlace) {
+  // Tests that a file of doubles is sorted in place.
+  std::mt19937_64 generator(11);
+  std::uniform_real_distribution<double> distribution(-1e9, 1e9);
+  std::vector<double> values(200000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = distribution(generator);
+  }
+  WriteFile(values);
+  MappedSort<double> sorter;
+  sorter.set_huge_pages(true);
+  EXPECT_TRUE(sorter.SortFile(path_));
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, ReadFile<double>());
+}
+
+TEST_F(MappedSortTest, TestStrategies) {
+  // Tests the in-place and hybrid strategies over the mapping.
+  std::mt19937 generator(7);
+  std::vector<int32_t> values(100000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<int32_t>(generator());
+  }
+  std::vector<int32_t> expected(values);
+  std::sort(expected.begin(), expected.end());
+  for (SortStrategy strategy : {IN_PLACE_MSD, HYBRID}) {
+    WriteFile(values);
+    MappedSort<int32_t> sorter;
+    sorter.sorter()->set_strategy(strategy);
+    EXPECT_TRUE(sorter.SortFile(path_));
+    EXPECT_EQ(expected, ReadFile<int32_t>());
+  }
+}
+
+TEST_F(MappedSortTest, TestEmptyFile) {
+  // Tests that an empty file is left alone.
+  WriteFile(std::vector<uint64_t>());
+  MappedSort<uint64_t> sorter;
+  EXPECT_TRUE(sorter.SortFile(path_));
+  EXPECT_TRUE(ReadFile<uint64_t>().empty());
+}
+
+TEST_F(MappedSortTest, TestBadFiles) {
+  // Tests that missing files and partial keys are reported.
+  MappedSort<uint64_t> sorter;
+  EXPECT_FALSE(sorter.SortFile(path_ + "_missing"));
+  WriteFile(std::vector<uint8_t>({1, 2, 3}));
+  EXPECT_FALSE(sorter.SortFile(path_));
+  EXPECT_EQ(3, ReadFile<uint8_t>().size());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,226 @@
+// Copyright 2015 Kevin Melkowski
+
+#ifndef NUMA_TOPOLOGY_H_
+#define NUMA_TOPOLOGY_H_
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef RADIX_SORT_HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bytes of a base page.  Writing one key per page is enough to place it.
+const size_t kPageBytes = 4096;
+
+// NUMA nodes and the CPUs on each.  System() asks libnuma when built with
+// RADIX_SORT_HAVE_LIBNUMA (and linked with -lnuma), reads
+// /sys/devices/system/node on other Linux builds and is a single node holding
+// every CPU anywhere else.  Nodes without CPUs, such as memory only nodes,
+// are left out.
+class NumaTopology {
+ public:
+  // One node per entry of cpus, numbered from 0, e.g. to try the NUMA sort on
+  // a single node machine.
+  explicit NumaTopology(const std::vector<std::vector<int>>& cpus);
+
+  // The machine's topology, read once.
+  static const NumaTopology& System();
+
+  // Number of nodes, the system node id of one and the CPUs on it.
+  int nodes() const { return cpus_.size(); }
+  int node_id(const int node) const { return ids_[node]; }
+  const std::vector<int>& cpus(const int node) const { return cpus_[node]; }
+
+  // Restrict the calling thread to the CPUs of node.  Threads it starts
+  // afterwards inherit the restriction.  Returns false where threads can't
+  // be pinned, the thread then runs anywhere as before.
+  bool PinThread(const int node) const;
+
+  // CPUs in a sysfs cpulist such as "0-3,8,10-11".
+  static std::vector<int> ParseCpuList(const std::string& list);
+
+ private:
+  NumaTopology() {}
+
+  // Read the topology from libnuma or sysfs, empty if neither is available.
+  void ReadSystem();
+
+  std::vector<int> ids_;
+  std::vector<std::vector<int>> cpus_;
+};
+
+// Uninitialized memory meant for one node.  With libnuma the pages are bound
+// to the node.  Otherwise the kernel places every page on the node of the
+// thread that first writes it, so the memory should be written first from
+// threads pinned to the node.
+class NodeBuffer {
+ public:
+  NodeBuffer(const NumaTopology& topology, const int node, const size_t bytes);
+  ~NodeBuffer();
+
+  template <typename T>
+  T* Get() const {
+    return static_cast<T*>(data_);
+  }
+
+  // Bytes held, at least 1.
+  size_t bytes() const { return bytes_; }
+
+ private:
+  NodeBuffer(const NodeBuffer&) = delete;
+  NodeBuffer& operator=(const NodeBuffer&) = delete;
+
+  void* data_;
+  size_t bytes_;
+  bool bound_;
+};
+
+NumaTopology::NumaTopology(const std::vector<std::vector<int>>& cpus)
+    : cpus_(cpus) {
+  for (size_t node = 0; node < cpus_.size(); ++node) {
+    ids_.push_back(node);
+  }
+}
+
+const NumaTopology& NumaTopology::System() {
+  static const NumaTopology* topology = []() {
+    NumaTopology* system = new NumaTopology;
+    system->ReadSystem();
+    if (system->cpus_.empty()) {  // A single node with every CPU.
+      const int cpus =
+          std::max<int>(1, std::thread::hardware_concurrency());
+      system->ids_.push_back(0);
+      system->cpus_.emplace_back();
+      for (int cpu = 0; cpu < cpus; ++cpu) {
+        system->cpus_[0].push_back(cpu);
+      }
+    }
+    return system;
+  }();
+  return *topology;
+}
+
+void NumaTopology::ReadSystem() {
+#if defined(RADIX_SORT_HAVE_LIBNUMA)
+  if (numa_available() < 0) {
+    return;
+  }
+  bitmask* cpus = numa_allocate_cpumask();
+  for (int id = 0; id <= numa_max_node(); ++id) {
+    if (!numa_bitmask_isbitset(numa_all_nodes_ptr, id) ||
+        numa_node_to_cpus(id, cpus) != 0) {
+      continue;
+    }
+    std::vector<int> node_cpus;
+    for (unsigned int cpu = 0; cpu < cpus->size; ++cpu) {
+      if (numa_bitmask_isbitset(cpus, cpu)) {
+        node_cpus.push_back(cpu);
+      }
+    }
+    if (!node_cpus.empty()) {
+      ids_.push_back(id);
+      cpus_.push_back(node_cpus);
+    }
+  }
+  numa_free_cpumask(cpus);
+#elif defined(__linux__)
+  DIR* directory = opendir("/sys/devices/system/node");
+  if (directory == nullptr) {
+    return;
+  }
+  std::vector<int> ids;
+  while (const dirent* entry = readdir(directory)) {
+    const std::string name = entry->d_name;
+    if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+        name.find_first_not_of("0123456789", 4) == std::string::npos) {
+      ids.push_back(std::atoi(name.c_str() + 4));
+    }
+  }
+  closedir(directory);
+  std::sort(ids.begin(), ids.end());
+  for (const int id : ids) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) +
+                       "/cpulist");
+    std::string list;
+    std::getline(file, list);
+    const std::vector<int> node_cpus = ParseCpuList(list);
+    if (!node_cpus.empty()) {
+      ids_.push_back(id);
+      cpus_.push_back(node_cpus);
+    }
+  }
+#endif
+}
+
+bool NumaTopology::PinThread(const int node) const {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const int cpu : cpus_[node]) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return CPU_COUNT(&set) > 0 &&
+         pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+std::vector<int> NumaTopology::ParseCpuList(const std::string& list) {
+  // Comma separated CPUs and inclusive ranges, anything else ends the list.
+  std::vector<int> cpus;
+  const char* position = list.c_str();
+  while (*position >= '0' && *position <= '9') {
+    char* end;
+    const int first = std::strtol(position, &end, 10);
+    int last = first;
+    if (*end == '-') {
+      last = std::strtol(end + 1, &end, 10);
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+    position = *end == ',' ? end + 1 : end;
+  }
+  return cpus;
+}
+
+NodeBuffer::NodeBuffer(const NumaTopology& topology, const int node,
+                       const size_t bytes)
+    : data_(nullptr), bytes_(std::max<size_t>(1, bytes)), bound_(false) {
+#ifdef RADIX_SORT_HAVE_LIBNUMA
+  if (numa_available() >= 0) {
+    data_ = numa_alloc_onnode(bytes_, topology.node_id(node));
+    bound_ = data_ != nullptr;
+  }
+#endif
+  if (data_ == nullptr) {  // Large allocations come straight from mmap.
+    data_ = ::operator new(bytes_);
+  }
+}
+
+NodeBuffer::~NodeBuffer() {
+#ifdef RADIX_SORT_HAVE_LIBNUMA
+  if (bound_) {
+    numa_free(data_, bytes_);
+    return;
+  }
+#endif
+  ::operator delete(data_);
+}
+
+#endif  // NUMA_TOPOLOGY_H_
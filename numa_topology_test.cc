@@ -0,0 +1,79 @@
+// Copyright 2015 Kevin Melkowski
+
+#include "sort/radix_sort/numa_topology.h"
+
+#include <stdint.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class NumaTopologyTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    topology_.reset(new NumaTopology({{0}, {0}}));
+  }
+  std::unique_ptr<NumaTopology> topology_;
+};
+
+TEST_F(NumaTopologyTest, TestParseCpuList) {
+  // Tests single CPUs, ranges and the trailing newline sysfs leaves.
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}),
+            NumaTopology::ParseCpuList("0-3,8,10-11\n"));
+  EXPECT_EQ(std::vector<int>({5}), NumaTopology::ParseCpuList("5"));
+  EXPECT_TRUE(NumaTopology::ParseCpuList("").empty());
+}
+
+TEST_F(NumaTopologyTest, TestSystem) {
+  // Tests that every machine has at least one node with a CPU.
+  const NumaTopology& system = NumaTopology::System();
+  ASSERT_LE(1, system.nodes());
+  for (int node = 0; node < system.nodes(); ++node) {
+    EXPECT_FALSE(system.cpus(node).empty());
+  }
+  EXPECT_EQ(&system, &NumaTopology::System());
+}
+
+TEST_F(NumaTopologyTest, TestExplicitTopology) {
+  // Tests a topology given by hand, numbered from 0.
+  EXPECT_EQ(2, topology_->nodes());
+  EXPECT_EQ(1, topology_->node_id(1));
+  EXPECT_EQ(std::vector<int>({0}), topology_->cpus(1));
+}
+
+TEST_F(NumaTopologyTest, TestPinThread) {
+  // Tests pinning a thread that isn't the test's, CPU 0 always exists.
+  bool pinned = false;
+  std::thread thread([this, &pinned]() { pinned = topology_->PinThread(1); });
+  thread.join();
+#if defined(__linux__)
+  EXPECT_TRUE(pinned);
+#else
+  EXPECT_FALSE(pinned);
+#endif
+}
+
+TEST_F(NumaTopologyTest, TestNodeBuffer) {
+  // Tests that a node buffer is writable throughout, including an empty one.
+  NodeBuffer buffer(*topology_, 1, 1 << 20);
+  std::memset(buffer.Get<uint8_t>(), 13, 1 << 20);
+  EXPECT_EQ(13, buffer.Get<uint8_t>()[(1 << 20) - 1]);
+  NodeBuffer empty(*topology_, 0, 0);
+  EXPECT_NE(nullptr, empty.Get<uint64_t>());
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  return RUN_ALL_TESTS();
+}
@@ -3,17 +3,118 @@
 #ifndef RADIX_SORT_H_
 #define RADIX_SORT_H_
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 #include <memory>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "sort/radix_sort/histogram.h"
+#include "sort/radix_sort/numa_topology.h"
+#include "sort/radix_sort/scratch_buffer.h"
+#include "sort/radix_sort/sort_stats.h"
+
+// Smallest slice of the array handed to a single thread in parallel sorts.
+const int kMinElementsPerThread = 1 << 16;
+
+// Default cutoffs, see set_insertion_sort_size and set_comparison_sort_size.
+const int kInsertionSortSize = 32;
+const int kComparisonSortSize = 512;
+
+// SortSegments comparison sorts segments up to this size.  Lower than
+// kComparisonSortSize, which is for HYBRID buckets that already share their
+// top digit, since 8-bit digit passes win from here on.
+const int kSegmentComparisonSortSize = 64;
+
+// 16-bit segments of at least this size are counting sorted, smaller ones
+// take two 8-bit passes rather than walk 65536 buckets.
+const int kSegmentCountingSortSize = 1 << 14;
+
+// Default and largest set_presorted_runs values.
+const int kPresortedRuns = 8;
+const int kMaxPresortedRuns = 64;
+
+// How Sort orders the array.
+//   LSD: 11-bit least significant digit passes through a second buffer of the
+//        same size as the array.  Stable and the fastest in general.
+//   IN_PLACE_MSD: American flag sort, permutes 11-bit most significant digit
+//        buckets in place with cycle leaders and insertion sorts small
+//        buckets.  Only needs the histograms as extra memory.
+//   HYBRID: Small arrays are comparison sorted without building histograms.
+//        Larger ones are partitioned in place on the top 11-bit digit and
+//        each bucket is LSD, comparison or insertion sorted depending on its
+//        size, so skewed inputs only pay for the buckets that need it.
+enum SortStrategy { LSD, IN_PLACE_MSD, HYBRID };
+
+// How the LSD passes write elements into their buckets.
+//   DIRECT: Straight to the destination, 2048 scattered write streams.
+//   BUFFERED: Staged in a cache line sized buffer per bucket and copied out
+//        a full line at a time, easier on the TLB and L1 for large arrays.
+//   STREAMING: Like BUFFERED but flushed with non-temporal stores that bypass
+//        the cache, for arrays far larger than the last level cache.  Same as
+//        BUFFERED off x86-64.
+enum ScatterMode { DIRECT, BUFFERED, STREAMING };
+
+// Order of the sorted elements, equal elements keep their order either way.
+//   DESCENDING: LSD passes lay the buckets out from the highest digit down
+//        and MSD sorts invert the bits while flipping, so neither costs a
+//        reversal pass.
+enum SortOrder { ASCENDING, DESCENDING };
+
+// Bytes staged per bucket by the BUFFERED and STREAMING scatters.
+const int kCacheLineSize = 64;
+
+// Digit width of the LSD sorts by default, and the set_digit_bits value that
+// picks 8, 11 or 16 bits from the array and cache sizes instead.
+const int kDefaultDigitBits = 11;
+const int kAutoDigitBits = 0;
+
+// SortByKey carries records of at most this many trivially copyable bytes
+// through the passes with their keys, larger ones are sorted by index and
+// moved once at the end.
+const int kMaxDirectRecordSize = 16;
+
+// L2 cache size assumed when the system doesn't report one.
+const size_t kDefaultCacheSize = 256 * 1024;
+
+// Unsigned integer as wide as T, for keys of up to 8 bytes.
+template <typename T>
+using UnsignedBits = typename std::conditional<
+    sizeof(T) == 1, uint8_t,
+    typename std::conditional<
+        sizeof(T) == 2, uint16_t,
+        typename std::conditional<sizeof(T) == 4, uint32_t,
+                                  uint64_t>::type>::type>::type;
+
+// Bits of an integer or floating point value as an unsigned integer that
+// compares the way Sort orders T, signed zeros and NaNs included.  Lets
+// sorted runs be merged consistently with the sort.
+template <typename T>
+UnsignedBits<T> OrderedBits(const T value, const SortOrder order);
 
+// Scratch memory is kept between calls, so a RadixSort shouldn't be shared
+// between threads.
 class RadixSort {
  public:
   RadixSort();
 
+  // Sort 32 and 64-bit types with num_threads threads.  A value <= 0 uses one
+  // thread per hardware core.
+  explicit RadixSort(const int num_threads);
+
   // Perform Radix Sort for unsigned chars and shorts.
   template <typename T>
   void SortType(T* array, const int size, const enum SortType type);
@@ -24,15 +125,673 @@ class RadixSort {
   // Perform Radix Sort for unsigned long longs.
   void SortType(uint64_t* array, const int size, const enum SortType type);
 
-  // Sort the array with any standard data type, expects vectors for now.
+  // Perform an LSD Radix Sort on kDigitBits (8, 11 or 16) wide digits of
+  // unsigned ints and long longs, the pass count and histogram sizes follow at
+  // compile time.  Wider digits mean fewer passes over larger histograms.
+  template <int kDigitBits, typename T>
+  void SortDigits(T* array, const int size, const enum SortType type);
+
+  // Perform an in-place MSD Radix Sort on unsigned chars, shorts, ints and
+  // long longs.
+  template <typename T>
+  void InPlaceSortType(T* array, const int size, const enum SortType type);
+
+  // Sort the array with any standard data type.
   template <typename T>
   void Sort(std::vector<T>& array);  // NOLINT
 
+  // Sort size elements of any standard data type in place, for memory the
+  // caller owns such as a mapped file.
+  template <typename T>
+  void Sort(T* array, const int size);
+
+  // Sort size elements of input into output, leaving input untouched.  The
+  // single threaded LSD sorts read the input while counting and write their
+  // last pass straight to output, so there is no separate copy.  Otherwise,
+  // and for presorted input which isn't scanned for here, this is a copy
+  // followed by Sort(output, size).
+  template <typename T>
+  void Sort(const T* input, T* output, const int size);
+
+  // Sort every segment of data on its own, segment i being data[offsets[i],
+  // offsets[i + 1]), so offsets holds segments + 1 nondecreasing offsets.
+  // Meant for many small arrays: the scratch memory is shared by all the
+  // segments, every segment gets the sort that suits its size, digit widths
+  // included unless set_digit_bits asks for 8 or 16, and the segments are
+  // spread across num_threads() threads.  Always LSD, whatever the strategy.
+  template <typename T>
+  void SortSegments(T* data, const int* offsets, const int segments);
+
+  // Same for a vector, does nothing if the offsets run past its end.
+  template <typename T>
+  void SortSegments(std::vector<T>& data,  // NOLINT
+                    const std::vector<int>& offsets);
+
+#ifdef __SIZEOF_INT128__
+  // Perform Radix Sort for unsigned 128-bit integers on digit_bits() wide
+  // digits.  Always LSD, whatever the strategy.
+  void SortType(unsigned __int128* array, const int size,
+                const enum SortType type);
+
+  // Sort signed and unsigned 128-bit integers.
+  void Sort(std::vector<unsigned __int128>& array);  // NOLINT
+  void Sort(std::vector<__int128>& array);           // NOLINT
+#endif
+
+#if __cplusplus >= 201703L
+  // Perform an MSD Radix Sort on strings, one byte per level with strings
+  // that end first ordered first, i.e. like std::string_view::compare.  Only
+  // the views move, buckets of at most insertion_sort_size() strings are
+  // insertion sorted.
+  void SortStrings(std::string_view* strings, const int size);
+
+  // Sort string views lexicographically.
+  void Sort(std::vector<std::string_view>& array);  // NOLINT
+#endif
+
+  // Perform an LSD Radix Sort on fixed width byte keys, one 8-bit digit per
+  // byte, ordered like memcmp.
+  template <size_t N>
+  void SortBytes(std::array<uint8_t, N>* array, const int size);
+
+  // Sort fixed width byte keys such as hashes and UUIDs, ordered like memcmp.
+  template <size_t N>
+  void Sort(std::vector<std::array<uint8_t, N>>& array);  // NOLINT
+
+  // Perform Radix Sort on 8 and 16-bit keys, moving values with their keys.
+  template <typename T, typename V>
+  void SortPairsType(T* keys, V* values, const int size,
+                     const enum SortType type);
+
+  // Perform Radix Sort on 32-bit keys, moving values with their keys.
+  template <typename V>
+  void SortPairsType(uint32_t* keys, V* values, const int size,
+                     const enum SortType type);
+
+  // Perform Radix Sort on 64-bit keys, moving values with their keys.
+  template <typename V>
+  void SortPairsType(uint64_t* keys, V* values, const int size,
+                     const enum SortType type);
+
+  // Sort the keys with any standard data type and permute values alongside
+  // them.  Values are copied, so trivially copyable payloads move fastest.
+  // Does nothing if the vectors differ in size.
+  template <typename K, typename V>
+  void SortPairs(std::vector<K>& keys, std::vector<V>& values);  // NOLINT
+
+  // Sort interleaved key value pairs by key, stable for equal keys.
+  template <typename K, typename V>
+  void SortPairs(std::vector<std::pair<K, V>>& pairs);  // NOLINT
+
+  // Return the permutation of indices that sorts the array, stable for equal
+  // keys.  The array itself is left untouched.  I is expected to be uint32_t
+  // or uint64_t.
+  template <typename T, typename I = uint32_t>
+  std::vector<I> ArgSort(const std::vector<T>& array);
+
+  // Sort records by the arithmetic key key(record) returns, stable for equal
+  // keys.  Keys are extracted once and cached, see kMaxDirectRecordSize for
+  // how the records move.
+  template <typename R, typename KeyFunction>
+  void SortByKey(R* records, const int size, KeyFunction key);
+
+  // Same as above for a vector of records.
+  template <typename R, typename KeyFunction>
+  void SortByKey(std::vector<R>& records, KeyFunction key);  // NOLINT
+
+  // Sort records lexicographically by several keys, the first one most
+  // significant.  Keys may mix unsigned, signed and floating point types, each
+  // is ordered with its own flip.  Records move once, through their indices.
+  template <typename R, typename... KeyFunctions>
+  void SortByKeys(R* records, const int size, KeyFunctions... keys);
+
+  // Same as above for a vector of records.
+  template <typename R, typename... KeyFunctions>
+  void SortByKeys(std::vector<R>& records,  // NOLINT
+                  KeyFunctions... keys);
+
+  // Return the permutation that sorts the rows of the columns
+  // lexicographically, the first column most significant and stable for equal
+  // rows.  Returns an empty vector if the columns differ in size.
+  template <typename T, typename... Columns>
+  std::vector<uint32_t> ArgSortColumns(const std::vector<T>& column,
+                                       const std::vector<Columns>&... columns);
+
+  // Rearrange the array so array[k] is the element a full sort would put
+  // there, with nothing ordered before it behind it and nothing ordered after
+  // it in front of it.  Returns array[k], k is clamped to [0, size) and an
+  // empty array returns T().
+  template <typename T>
+  T Select(std::vector<T>& array, const int k);  // NOLINT
+
+  // Sort only the first k elements of the sorted order into array[0, k), the
+  // rest are left in unspecified order.
+  template <typename T>
+  void PartialSort(std::vector<T>& array, const int k);  // NOLINT
+
+  // Return the first k elements of the sorted order, i.e. the k smallest, or
+  // the k largest if DESCENDING.  The array is left untouched.
+  template <typename T>
+  std::vector<T> TopK(const std::vector<T>& array, const int k);
+
+  // Threads used by the 32 and 64-bit sorts.
+  int num_threads() const { return num_threads_; }
+  void set_num_threads(const int num_threads);
+
+  // NUMA nodes the parallel 32 and 64-bit LSD sorts are spread across, e.g.
+  // &NumaTopology::System(), none by default.  Keys are split by their top
+  // digit into one key range per node, each on memory of its node, and every
+  // range is sorted by threads pinned to its node so the scatters stay off
+  // the interconnect.  A single node topology sorts as before, and so does
+  // one whose threads can't be pinned to their nodes.  The node buffers and
+  // the sorters of every node are kept for the next sort like the rest of
+  // the scratch memory.  Not owned.
+  const NumaTopology* numa_topology() const { return numa_topology_; }
+  void set_numa_topology(const NumaTopology* topology) {
+    if (topology != numa_topology_) {
+      ReleaseNodeScratch();
+    }
+    numa_topology_ = topology;
+  }
+
+  // Perform a hybrid MSD/LSD Radix Sort, see HYBRID.
+  template <typename T>
+  void HybridSortType(T* array, const int size, const enum SortType type);
+
+  // Strategy used by Sort, LSD by default.
+  SortStrategy strategy() const { return strategy_; }
+  void set_strategy(const SortStrategy strategy) { strategy_ = strategy; }
+
+  // Order of every sort, ASCENDING by default.
+  SortOrder order() const { return order_; }
+  void set_order(const SortOrder order) { order_ = order; }
+
+  // Scatter used by the 32 and 64-bit LSD passes, DIRECT by default.
+  ScatterMode scatter_mode() const { return scatter_mode_; }
+  void set_scatter_mode(const ScatterMode mode) { scatter_mode_ = mode; }
+
+  // Digit width of the single threaded 32 and 64-bit LSD sorts, 8, 11 or 16
+  // bits, or kAutoDigitBits to pick one per array with TunedDigitBits.
+  // kDefaultDigitBits by default, other values fall back to it.
+  int digit_bits() const { return digit_bits_; }
+  void set_digit_bits(const int bits) { digit_bits_ = bits; }
+
+  // Instruction set of the 32 and 64-bit histograms, SCALAR by default, see
+  // Histogram::set_simd_level.
+  SimdLevel simd_level() const { return histogram_->simd_level(); }
+  void set_simd_level(const SimdLevel level) {
+    histogram_->set_simd_level(level);
+  }
+
+  // L2 cache size in bytes used to tune the digit width, detected from the
+  // system when available.
+  size_t cache_size() const { return cache_size_; }
+  void set_cache_size(const size_t bytes) { cache_size_ = bytes; }
+
+  // Digit width kAutoDigitBits picks for size keys of key_bytes bytes.
+  int TunedDigitBits(const int size, const int key_bytes) const;
+
+  // MSD buckets (IN_PLACE_MSD and HYBRID) of at most this many elements are
+  // insertion sorted.
+  int insertion_sort_size() const { return insertion_sort_size_; }
+  void set_insertion_sort_size(const int size) { insertion_sort_size_ = size; }
+
+  // HYBRID arrays and buckets of at most this many elements are comparison
+  // sorted instead of radix sorted.
+  int comparison_sort_size() const { return comparison_sort_size_; }
+  void set_comparison_sort_size(const int size) {
+    comparison_sort_size_ = size;
+  }
+
+  // 32 and 64-bit sorts first scan for keys that are already in order.
+  // Sorted input is left as is, reversed input is reversed and input of at
+  // most this many ascending runs is merged instead of radix sorted.  The
+  // scan gives up as soon as there are more runs, a few dozen keys into
+  // random input.  0 turns the scan off.
+  int presorted_runs() const { return presorted_runs_; }
+  void set_presorted_runs(const int runs) {
+    presorted_runs_ = std::max(0, std::min(runs, kMaxPresortedRuns));
+  }
+
+  // Number of times scratch memory was allocated.  Sorting arrays no larger
+  // than a previous one doesn't allocate.
+  int scratch_allocations() const;
+
+  // Bytes of scratch memory currently held.
+  size_t scratch_bytes() const;
+
+  // Free the scratch memory, e.g. after sorting an unusually large array.
+  void ReleaseScratch();
+
+  // Stats the LSD sorts add their phase times, bytes moved and passes to,
+  // none by default.  Only filled in when built with RADIX_SORT_STATS.
+  SortStats* stats() const { return stats_; }
+  void set_stats(SortStats* stats);
+
  private:
+  // Perform a parallel LSD Radix Sort over passes 11-bit digits.  Each thread
+  // owns a contiguous chunk and a histogram per pass, the histograms are
+  // combined into per-thread offsets so the scatter stays stable.
+  template <typename T>
+  void ParallelSortType(T* array, const int size, const enum SortType type,
+                        const int passes);
+
+  // Perform the parallel LSD Radix Sort node by node, see set_numa_topology.
+  template <typename T>
+  void NumaSortType(T* array, const int size, const enum SortType type);
+
+  // Sort the segments of unsigned chars, shorts, ints and long longs, split
+  // into runs of about equal elements across threads.
+  template <typename T>
+  void SortSegmentsType(T* data, const int* offsets, const int segments,
+                        const enum SortType type);
+
+  // Sort segments [first, last) one after the other on this sorter.
+  template <typename T>
+  void SortSegmentRange(T* data, const int* offsets, const int first,
+                        const int last, const enum SortType type);
+
+  // Sort one segment with the sort that suits its size.
+  template <typename T>
+  void SortSegment(T* array, const int size, const enum SortType type);
+
+  // Take on every setting of other but the threads and stats.
+  void CopySettings(const RadixSort& other);
+
+  // Run the kDigitBits wide LSD passes of the flat histogram over the array,
+  // in descending order if descending.  The flipped keys are in the array,
+  // or in the placeholder if staged, and the sorted keys end up in the
+  // array either way.  Staging them pays off with an odd number of passes,
+  // the last one then lands in the array without a copy back.
+  template <int kDigitBits, typename T>
+  void SortPasses(T* array, const int size, const enum SortType type,
+                  kHistogramDataType* histogram, const int passes,
+                  const bool descending, const bool staged);
+
+  // SortDigits from input into array, which may be the same.
+  template <int kDigitBits, typename T>
+  void SortDigits(const T* input, T* array, const int size,
+                  const enum SortType type);
+
+  // SortDigits from input into array on the digit width digit_bits() picks
+  // for the size.
+  template <typename T>
+  void SortDigitsFor(const T* input, T* array, const int size,
+                     const enum SortType type);
+
+  // Counting sort of 8 and 16-bit keys from input into output, which may be
+  // the same.  Keys are the whole value, so when most buckets hold a key
+  // output is written straight from the counts, without a scatter or a copy
+  // back.  Otherwise the keys are scattered straight into output.
+  template <typename T>
+  void CountingSort(const T* input, T* output, const int size,
+                    const enum SortType type);
+
+  // Turn the prefix sum of a digit into the bucket ends of a descending
+  // scatter, with the highest digit's bucket first.
+  void ReverseOffsets(kHistogramDataType* offset, const int buckets,
+                      const int size);
+
+  // Scatter source into destination on the kDigitBits wide digit at pass
+  // through the per bucket line buffers, applying transform to every element.
+  // offset holds the bucket ends of the digit, see ReverseOffsets for
+  // descending.
+  template <int kDigitBits, typename T, typename Transform>
+  void BufferedScatter(const T* source, T* destination, const int size,
+                       const int pass, const kHistogramDataType* offset,
+                       const bool descending, Transform transform);
+
+  // Copy count elements from a line buffer to destination.
+  template <typename T>
+  void FlushLine(const T* line, T* destination, const int count);
+
+  // Flip signed and floating point values in place, also inverting all bits
+  // if invert so MSD sorts order them descending.
+  template <typename T>
+  void FlipArray(T* array, const int size, const enum SortType type,
+                 const bool invert);
+
+  // Flop signed and floating point values back in place, undoing invert.
+  template <typename T>
+  void FlopArray(T* array, const int size, const enum SortType type,
+                 const bool invert);
+
+  // Sort flipped values in place on the 11-bit digit at pass and then each
+  // bucket on the lower digits.  Each pass uses its own 2 * 2048 entries of
+  // the levels block.
+  template <typename T>
+  void AmericanFlagSort(T* array, const int size, const int pass,
+                        kHistogramDataType* levels);
+
+  // Move flipped values into their 11-bit digit bucket at pass in place.
+  // ends is filled with the prefix sum of the digit, heads is used while
+  // permuting.
+  template <typename T>
+  void PartitionDigit(T* array, const int size, const int pass,
+                      kHistogramDataType* heads, kHistogramDataType* ends);
+
+  // Insertion sort flipped values, used for small buckets.
+  template <typename T>
+  void InsertionSort(T* array, const int size);
+
+  // Insertion or comparison sort flipped values depending on size.
+  template <typename T>
+  void SmallSort(T* array, const int size);
+
+  // Detect the key type of the array and run SelectType.
+  template <typename T>
+  void SelectArray(T* array, const int size, const int nth,
+                   const bool sort_prefix);
+
+  // Put the element of sorted position nth in place, also sorting the ones
+  // before it if sort_prefix.  Only the MSD bucket holding nth is counted
+  // and partitioned further at each level.
+  template <typename T>
+  void SelectType(T* array, const int size, const int nth,
+                  const enum SortType type, const bool sort_prefix);
+
+  // Select on the digits of transform(value), the flipped value, so only the
+  // elements that end up sorted are ever flipped.  See SelectType.
+  template <typename T, typename Transform>
+  void SelectDigits(T* array, const int size, int nth, Transform transform);
+
+  // Sort the array with the strategy_.
+  template <typename T>
+  void SortWithStrategy(T* array, const int size, const enum SortType type);
+
+  // Finish sorting presorted input, see set_presorted_runs.  Returns false,
+  // with the array untouched, if it isn't presorted.
+  template <typename T>
+  bool SortPresorted(T* array, const int size, const enum SortType type);
+
+  // SortPresorted on the keys transform(value), flipped and inverted if
+  // descending.
+  template <typename T, typename Transform>
+  bool SortPresortedKeys(T* array, const int size, Transform transform);
+
+  // Run the 11-bit LSD passes of the flat histogram over keys and values.
+  template <typename T, typename V>
+  void SortPairsPasses(T* keys, V* values, const int size,
+                       const enum SortType type, kHistogramDataType* histogram,
+                       const int passes);
+
+  // Sort keys of any standard data type with their values.
+  template <typename K, typename V>
+  void SortPairsArray(K* keys, V* values, const int size);
+
+#if __cplusplus >= 201703L
+  // Strings from begin to begin + size that share their first depth bytes.
+  struct StringRange {
+    int begin;
+    int size;
+    size_t depth;
+  };
+
+  // Sort strings that share their first depth bytes.  prefixes holds the 8
+  // bytes of each string from depth rounded down to a multiple of 8, so most
+  // levels read the cached prefixes instead of the strings.  The scratch
+  // arrays hold size entries.
+  void StringMsdSort(std::string_view* strings, uint64_t* prefixes,
+                     const int size, const size_t depth,
+                     std::string_view* scratch_strings,
+                     uint64_t* scratch_prefixes);
+
+  // Insertion sort strings that share their first depth bytes.
+  void StringInsertionSort(std::string_view* strings, uint64_t* prefixes,
+                           const int size, const size_t depth);
+
+  // Count the byte at depth of every string into 257 bucket ends, moving
+  // depth past bytes every string shares.  Returns false if every string
+  // ended, the strings are then equal.
+  bool CountStringDigits(std::string_view* strings, uint64_t* prefixes,
+                         const int size, size_t* depth,
+                         kHistogramDataType* histogram);
+
+  // Byte at depth of a string plus 1 read from its cached prefix, 0 if the
+  // string is shorter.
+  int StringDigit(const std::string_view string, const uint64_t prefix,
+                  const size_t depth);
+
+  // Load the 8 bytes of string from depth big endian, zero padded.
+  uint64_t LoadPrefix(const std::string_view string, const size_t depth);
+#endif
+
+  // Stable sort indices by each index's keys, least significant key first so
+  // the first one ends up deciding.  A key that is the same for every index
+  // has only trivial digits and skips all of its passes.
+  template <typename I>
+  void SortIndicesByKeys(I* indices, const int size) {}
+  template <typename I, typename KeyFunction, typename... KeyFunctions>
+  void SortIndicesByKeys(I* indices, const int size, KeyFunction key,
+                         KeyFunctions... keys);
+
+  // Move records into the order given by indices, indices[i] being the record
+  // that belongs at i.  Follows the cycles so every record moves once, and
+  // leaves indices as the identity.
+  template <typename R, typename I>
+  void ApplyPermutation(R* records, I* indices, const int size);
+
+  // Room for size values.  Trivially copyable values live in
+  // placeholder_values_, anything else in the fallback vector.
+  template <typename V>
+  V* GetValueScratch(const int size, std::vector<V>* fallback);
+
+  // Fill active with which of the passes over the kDigitBits wide histograms
+  // aren't trivial, returns how many there are.
+  template <int kDigitBits>
+  int GetActivePasses(const kHistogramDataType* histogram, const int passes,
+                      const int size, int* active);
+
+  // Digit width to sort size elements of key_bytes bytes with.
+  int DigitBitsFor(const int size, const int key_bytes) const;
+
+  // L2 cache size reported by the system, kDefaultCacheSize if unknown.
+  static size_t DetectCacheSize();
+
+  // Detect if T is unsigned, signed or float for sorting, false if T can't be
+  // sorted.
+  template <typename T>
+  bool DetectSortType(enum SortType* type);
+
+  // Run function(thread) on num_threads threads, including the caller.
+  template <typename Function>
+  void RunParallel(const int num_threads, Function function);
+
+  // Run function(worker) on a new thread per worker, pinned to the node
+  // worker_nodes[worker] of the NUMA topology.  Returns false if a worker
+  // couldn't be pinned, it still ran on whatever CPU it got.
+  template <typename Function>
+  bool RunOnNodes(const std::vector<int>& worker_nodes, Function function);
+
+  // Free the node buffers and node sorters of the NUMA sort, keeping count
+  // of their allocations.
+  void ReleaseNodeScratch();
+
   std::unique_ptr<Histogram> histogram_;
+  int num_threads_;
+  SortStrategy strategy_;
+  int insertion_sort_size_;
+  int comparison_sort_size_;
+  int presorted_runs_;
+  ScatterMode scatter_mode_;
+  SortOrder order_;
+  int digit_bits_;
+  size_t cache_size_;
+  SortStats* stats_;
+  const NumaTopology* numa_topology_;
+
+  // Sorters of the threads past the first in SortSegments, kept so their
+  // scratch memory is reused between calls.
+  std::vector<std::unique_ptr<RadixSort>> segment_sorters_;
+
+  // Reused scratch memory, see scratch_allocations().
+  ScratchBuffer placeholder_;         // Second buffer of the ping pong.
+  ScratchBuffer placeholder_values_;  // Second value buffer for pairs.
+  ScratchBuffer histogram_block_;     // Flat histograms and thread offsets.
+  ScratchBuffer key_copy_;            // Keys copied by ArgSort and pairs.
+  ScratchBuffer record_indices_;      // Indices of indirect SortByKey.
+  ScratchBuffer line_buffer_;         // Per bucket lines of the scatter.
+
+  // Key range of every node in the NUMA sort, on that node's memory, and
+  // the sorter of every node, created on the node so its scratch memory is
+  // too.  node_allocations_ counts the buffers and the allocations of freed
+  // sorters.
+  std::vector<std::unique_ptr<NodeBuffer>> node_buffers_;
+  std::vector<std::unique_ptr<RadixSort>> node_sorters_;
+  int node_allocations_;
 };
 
-RadixSort::RadixSort() { histogram_.reset(new Histogram); }
+template <typename T>
+UnsignedBits<T> OrderedBits(const T value, const SortOrder order) {
+  // Same flips as Histogram, with the descending inversion on top.
+  typedef UnsignedBits<T> Bits;
+  const Bits sign = static_cast<Bits>(Bits(1) << (8 * sizeof(Bits) - 1));
+  Bits bits;
+  memcpy(&bits, &value, sizeof(T));
+  if (!std::numeric_limits<T>::is_integer) {
+    bits = (bits & sign) ? static_cast<Bits>(~bits)
+                         : static_cast<Bits>(bits ^ sign);
+  } else if (std::numeric_limits<T>::is_signed) {
+    bits ^= sign;
+  }
+  return order == DESCENDING ? static_cast<Bits>(~bits) : bits;
+}
+
+RadixSort::RadixSort()
+    : num_threads_(1),
+      strategy_(LSD),
+      insertion_sort_size_(kInsertionSortSize),
+      comparison_sort_size_(kComparisonSortSize),
+      presorted_runs_(kPresortedRuns),
+      scatter_mode_(DIRECT),
+      order_(ASCENDING),
+      digit_bits_(kDefaultDigitBits),
+      cache_size_(DetectCacheSize()),
+      stats_(nullptr),
+      numa_topology_(nullptr),
+      node_allocations_(0) {
+  histogram_.reset(new Histogram);
+}
+
+RadixSort::RadixSort(const int num_threads)
+    : strategy_(LSD),
+      insertion_sort_size_(kInsertionSortSize),
+      comparison_sort_size_(kComparisonSortSize),
+      presorted_runs_(kPresortedRuns),
+      scatter_mode_(DIRECT),
+      order_(ASCENDING),
+      digit_bits_(kDefaultDigitBits),
+      cache_size_(DetectCacheSize()),
+      stats_(nullptr),
+      numa_topology_(nullptr),
+      node_allocations_(0) {
+  histogram_.reset(new Histogram);
+  set_num_threads(num_threads);
+}
+
+void RadixSort::set_stats(SortStats* stats) {
+  stats_ = stats;
+  histogram_->set_stats(stats);
+}
+
+void RadixSort::CopySettings(const RadixSort& other) {
+  strategy_ = other.strategy_;
+  insertion_sort_size_ = other.insertion_sort_size_;
+  comparison_sort_size_ = other.comparison_sort_size_;
+  presorted_runs_ = other.presorted_runs_;
+  scatter_mode_ = other.scatter_mode_;
+  order_ = other.order_;
+  digit_bits_ = other.digit_bits_;
+  cache_size_ = other.cache_size_;
+  histogram_->set_simd_level(other.histogram_->simd_level());
+}
+
+void RadixSort::set_num_threads(const int num_threads) {
+  num_threads_ = num_threads;
+  if (num_threads_ <= 0) {  // hardware_concurrency may also return 0.
+    num_threads_ = std::max<int>(1, std::thread::hardware_concurrency());
+  }
+}
+
+size_t RadixSort::DetectCacheSize() {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  const long bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);  // NOLINT
+  if (bytes > 0) {
+    return bytes;
+  }
+#endif
+  return kDefaultCacheSize;
+}
+
+int RadixSort::TunedDigitBits(const int size, const int key_bytes) const {
+  // Every bucket costs a histogram entry and a cache line of scatter
+  // destination, so wide digits only pay off once they save a pass over
+  // enough elements.  16-bit digits also need their histograms to fit in
+  // half of L2, leaving the rest to the scattered lines.
+  const size_t wide_histograms = (8 * key_bytes / 16) * (1 << 16) *
+                                 sizeof(kHistogramDataType);
+  if (size >= (1 << 23) && wide_histograms <= cache_size_ / 2) {
+    return 16;
+  }
+  if (size <= (1 << 10)) {
+    return 8;
+  }
+  return 11;
+}
+
+int RadixSort::DigitBitsFor(const int size, const int key_bytes) const {
+  // Unsupported widths sort like the default.
+  if (digit_bits_ == kAutoDigitBits) {
+    return TunedDigitBits(size, key_bytes);
+  }
+  if (digit_bits_ == 8 || digit_bits_ == 16) {
+    return digit_bits_;
+  }
+  return kDefaultDigitBits;
+}
+
+int RadixSort::scratch_allocations() const {
+  int allocations =
+      placeholder_.allocations() + placeholder_values_.allocations() +
+      histogram_block_.allocations() + key_copy_.allocations() +
+      record_indices_.allocations() + line_buffer_.allocations() +
+      node_allocations_;
+  for (const auto& sorter : node_sorters_) {
+    allocations += sorter != nullptr ? sorter->scratch_allocations() : 0;
+  }
+  return allocations;
+}
+
+size_t RadixSort::scratch_bytes() const {
+  size_t bytes = placeholder_.capacity() + placeholder_values_.capacity() +
+                 histogram_block_.capacity() + key_copy_.capacity() +
+                 record_indices_.capacity() + line_buffer_.capacity();
+  for (const auto& buffer : node_buffers_) {
+    bytes += buffer != nullptr ? buffer->bytes() : 0;
+  }
+  for (const auto& sorter : node_sorters_) {
+    bytes += sorter != nullptr ? sorter->scratch_bytes() : 0;
+  }
+  return bytes;
+}
+
+void RadixSort::ReleaseScratch() {
+  placeholder_.Release();
+  placeholder_values_.Release();
+  histogram_block_.Release();
+  key_copy_.Release();
+  record_indices_.Release();
+  line_buffer_.Release();
+  ReleaseNodeScratch();
+}
+
+void RadixSort::ReleaseNodeScratch() {
+  for (const auto& sorter : node_sorters_) {
+    node_allocations_ += sorter != nullptr ? sorter->scratch_allocations() : 0;
+  }
+  node_sorters_.clear();
+  node_buffers_.clear();
+}
 
 template <typename T>
 void RadixSort::SortType(T* array, const int size, const enum SortType type) {
@@ -40,139 +799,1761 @@ void RadixSort::SortType(T* array, const int size, const enum SortType type) {
   if (size == 0 || type == FLOAT) {
     return;
   }
-  std::vector<kHistogramDataType> T_hist =
-      histogram_->GetHistogram(array, size, type);
-  std::vector<T> placeholder_array(size);
-  for (int i = size - 1; i >= 0; --i) {
-    placeholder_array[--T_hist[array[i]]] = array[i];
+  CountingSort(array, array, size, type);
+}
+
+template <typename T>
+void RadixSort::CountingSort(const T* input, T* output, const int size,
+                             const enum SortType type) {
+  // Count the flipped keys.  Counting finishes before anything is written.
+  const int buckets = std::numeric_limits<T>::max() + 1;
+  const T flip = type == UNSIGNED ? T(0) : histogram_->FlipFlopInteger(T(0));
+  kHistogramDataType* counts =
+      histogram_block_.Get<kHistogramDataType>(buckets);
+  {
+    RADIX_SORT_PHASE(stats_, HISTOGRAM_PHASE);
+    std::fill(counts, counts + buckets, 0);
+    for (int i = 0; i < size; ++i) {
+      ++counts[static_cast<T>(input[i] ^ flip)];
+    }
   }
-  if (type == UNSIGNED) {  // No Flip Flop.
-    for (int i = 0; i < placeholder_array.size(); ++i) {
-      array[i] = placeholder_array[i];
+  RADIX_SORT_COUNT(stats_, passes, 1);
+  RADIX_SORT_COUNT(stats_, bytes_moved, size * sizeof(T));
+  RADIX_SORT_PHASE(stats_, SCATTER_PHASE);
+  if (size >= 2 * buckets) {  // Dense, write every key out count times.
+    const int direction = order_ == DESCENDING ? buckets - 1 : 0;
+    for (int i = 0; i < buckets; ++i) {
+      const int bucket = i ^ direction;
+      if (counts[bucket] != 0) {
+        output = std::fill_n(output, counts[bucket],
+                             static_cast<T>(bucket ^ flip));
+      }
     }
-  } else {  // Use FlipFlopInteger.
-    for (int i = 0; i < placeholder_array.size(); ++i) {
-      array[i] = histogram_->FlipFlopInteger(placeholder_array[i]);
+    return;
+  }
+  // Sparse, walking every bucket would cost more than a scatter.  Scattering
+  // in place needs the keys staged in the placeholder first.
+  const T* source = input;
+  if (input == output) {
+    RADIX_SORT_COUNT(stats_, bytes_moved, size * sizeof(T));
+    T* staged = placeholder_.Get<T>(size);
+    std::copy(input, input + size, staged);
+    source = staged;
+  }
+  {
+    RADIX_SORT_PHASE(stats_, PREFIX_SUM_PHASE);
+    for (int bucket = 1; bucket < buckets; ++bucket) {
+      counts[bucket] += counts[bucket - 1];
     }
   }
+  if (order_ == DESCENDING) {
+    ReverseOffsets(counts, buckets, size);
+  }
+  for (int i = size - 1; i >= 0; --i) {
+    output[--counts[static_cast<T>(source[i] ^ flip)]] = source[i];
+  }
 }
 
 void RadixSort::SortType(uint32_t* array, const int size,
                          const enum SortType type) {
   // Sort all 32-bit data types based on uint32_t bit structure.
-  if (size == 0) {
+  if (size == 0 || SortPresorted(array, size, type)) {
     return;
   }
-  std::vector<std::vector<kHistogramDataType>> int_hist =
-      histogram_->GetHistogram(array, size, type);
-  std::vector<uint32_t> placeholder_array(size);
-  for (int i = size - 1; i >= 0; --i) {
-    placeholder_array[--int_hist[0][histogram_->ExtractBit(array[i], 0)]] =
-        array[i];
-  }
-  for (int i = size - 1; i >= 0; --i) {
-    array[--int_hist[1][histogram_->ExtractBit(placeholder_array[i], 1)]] =
-        placeholder_array[i];
-  }
-  for (int i = size - 1; i >= 0; --i) {
-    placeholder_array[--int_hist[2][histogram_->ExtractBit(array[i], 2)]] =
-        array[i];
-  }
-
-  if (type == UNSIGNED) {  // No Flip Flop.
-    for (int i = 0; i < placeholder_array.size(); ++i) {
-      array[i] = placeholder_array[i];
-    }
-  } else if (type == SIGNED) {  // Use FlipFlopInteger.
-    for (int i = 0; i < placeholder_array.size(); ++i) {
-      array[i] = histogram_->FlipFlopInteger(placeholder_array[i]);
-    }
-  } else {  // Use FlopFloatingPoint.
-    for (int i = 0; i < placeholder_array.size(); ++i) {
-      array[i] = histogram_->FlopFloatingPoint(placeholder_array[i]);
+  if (num_threads_ > 1 && size >= 2 * kMinElementsPerThread) {
+    if (numa_topology_ != nullptr && numa_topology_->nodes() > 1) {
+      NumaSortType(array, size, type);
+    } else {
+      ParallelSortType(array, size, type, 3);
     }
+    return;
   }
+  SortDigitsFor(array, array, size, type);
 }
 
 void RadixSort::SortType(uint64_t* array, const int size,
                          const enum SortType type) {
   // Sort all 64-bit data types based on uint64_t bit structure.
-  if (size == 0) {
+  if (size == 0 || SortPresorted(array, size, type)) {
     return;
   }
-  std::vector<std::vector<kHistogramDataType>> ULL_hist =
-      histogram_->GetHistogram(array, size, type);
-  std::vector<uint64_t> placeholder_array(size);
-  for (int i = size - 1; i >= 0; --i) {
-    placeholder_array[--ULL_hist[0][histogram_->ExtractBit(array[i], 0)]] =
-        array[i];
+  if (num_threads_ > 1 && size >= 2 * kMinElementsPerThread) {
+    if (numa_topology_ != nullptr && numa_topology_->nodes() > 1) {
+      NumaSortType(array, size, type);
+    } else {
+      ParallelSortType(array, size, type, 6);
+    }
+    return;
   }
-  for (int i = size - 1; i >= 0; --i) {
-    array[--ULL_hist[1][histogram_->ExtractBit(placeholder_array[i], 1)]] =
-        placeholder_array[i];
+  SortDigitsFor(array, array, size, type);
+}
+
+#ifdef __SIZEOF_INT128__
+void RadixSort::SortType(unsigned __int128* array, const int size,
+                         const enum SortType type) {
+  // Sort 128-bit integers, digit passes follow from the width.
+  switch (DigitBitsFor(size, sizeof(*array))) {
+    case 8:
+      SortDigits<8>(array, size, type);
+      break;
+    case 16:
+      SortDigits<16>(array, size, type);
+      break;
+    default:
+      SortDigits<11>(array, size, type);
   }
-  for (int i = size - 1; i >= 0; --i) {
-    placeholder_array[--ULL_hist[2][histogram_->ExtractBit(array[i], 2)]] =
-        array[i];
+}
+
+void RadixSort::Sort(std::vector<unsigned __int128>& array) {  // NOLINT
+  SortType(array.data(), array.size(), UNSIGNED);
+}
+
+void RadixSort::Sort(std::vector<__int128>& array) {  // NOLINT
+  SortType(reinterpret_cast<unsigned __int128*>(array.data()), array.size(),
+           SIGNED);
+}
+#endif
+
+#if __cplusplus >= 201703L
+void RadixSort::SortStrings(std::string_view* strings, const int size) {
+  // Cache the first 8 bytes of every string, then sort from the first byte.
+  uint64_t* prefixes = key_copy_.Get<uint64_t>(size);
+  for (int i = 0; i < size; ++i) {
+    prefixes[i] = LoadPrefix(strings[i], 0);
   }
-  for (int i = size - 1; i >= 0; --i) {
-    array[--ULL_hist[3][histogram_->ExtractBit(placeholder_array[i], 3)]] =
-        placeholder_array[i];
+  StringMsdSort(strings, prefixes, size, 0,
+                placeholder_.Get<std::string_view>(size),
+                placeholder_values_.Get<uint64_t>(size));
+}
+
+void RadixSort::Sort(std::vector<std::string_view>& array) {  // NOLINT
+  SortStrings(array.data(), array.size());
+}
+
+void RadixSort::StringMsdSort(std::string_view* strings, uint64_t* prefixes,
+                              const int size, const size_t depth,
+                              std::string_view* scratch_strings,
+                              uint64_t* scratch_prefixes) {
+  // Count the byte at depth, distribute through the scratch arrays and sort
+  // every byte bucket from the next byte.  Buckets wait on a work stack
+  // instead of recursing, strings that are prefixes of each other only drop
+  // one string a level.  Bucket 0 holds the strings that ended, they are all
+  // equal by now.
+  const bool descending = order_ == DESCENDING;
+  kHistogramDataType histogram[257];
+  std::vector<StringRange> ranges(1, StringRange{0, size, depth});
+  while (!ranges.empty()) {
+    const StringRange range = ranges.back();
+    ranges.pop_back();
+    std::string_view* range_strings = strings + range.begin;
+    uint64_t* range_prefixes = prefixes + range.begin;
+    size_t range_depth = range.depth;
+    if (range.size <= insertion_sort_size_) {
+      StringInsertionSort(range_strings, range_prefixes, range.size,
+                          range_depth);
+      continue;
+    }
+    if (!CountStringDigits(range_strings, range_prefixes, range.size,
+                           &range_depth, histogram)) {
+      continue;
+    }
+    if (descending) {
+      ReverseOffsets(histogram, 257, range.size);
+    }
+    for (int i = range.size - 1; i >= 0; --i) {
+      const kHistogramDataType index = --histogram[StringDigit(
+          range_strings[i], range_prefixes[i], range_depth)];
+      scratch_strings[index] = range_strings[i];
+      scratch_prefixes[index] = range_prefixes[i];
+    }
+    std::copy(scratch_strings, scratch_strings + range.size, range_strings);
+    std::copy(scratch_prefixes, scratch_prefixes + range.size,
+              range_prefixes);
+    // histogram now holds the bucket starts, the next bucket is the next
+    // digit or the previous one if descending.
+    for (int digit = 1; digit < 257; ++digit) {
+      const int begin = histogram[digit];
+      int end = digit == 256 ? range.size : histogram[digit + 1];
+      if (descending) {
+        end = histogram[digit - 1];
+      }
+      if (end - begin > 1) {
+        ranges.push_back(
+            StringRange{range.begin + begin, end - begin, range_depth + 1});
+      }
+    }
   }
-  for (int i = size - 1; i >= 0; --i) {
-    placeholder_array[--ULL_hist[4][histogram_->ExtractBit(array[i], 4)]] =
-        array[i];
+}
+
+void RadixSort::StringInsertionSort(std::string_view* strings,
+                                    uint64_t* prefixes, const int size,
+                                    const size_t depth) {
+  // Compare the unsorted suffixes only.
+  const bool descending = order_ == DESCENDING;
+  for (int i = 1; i < size; ++i) {
+    const std::string_view string = strings[i];
+    const uint64_t prefix = prefixes[i];
+    int j = i;
+    for (; j > 0 && (descending
+                         ? strings[j - 1].substr(depth) < string.substr(depth)
+                         : strings[j - 1].substr(depth) > string.substr(depth));
+         --j) {
+      strings[j] = strings[j - 1];
+      prefixes[j] = prefixes[j - 1];
+    }
+    strings[j] = string;
+    prefixes[j] = prefix;
   }
-  if (type == UNSIGNED) {  // No Flip Flop.
-    for (int i = size - 1; i >= 0; --i) {
-      array[--ULL_hist[5][histogram_->ExtractBit(placeholder_array[i], 5)]] =
-          placeholder_array[i];
+}
+
+bool RadixSort::CountStringDigits(std::string_view* strings,
+                                  uint64_t* prefixes, const int size,
+                                  size_t* depth,
+                                  kHistogramDataType* histogram) {
+  // Levels where every string has the same byte move nothing, skip them.
+  while (true) {
+    if (*depth % 8 == 0 && *depth > 0) {  // Used up the cached bytes.
+      for (int i = 0; i < size; ++i) {
+        prefixes[i] = LoadPrefix(strings[i], *depth);
+      }
     }
-  } else if (type == SIGNED) {  // Use FlipFlopInteger.
-    for (int i = size - 1; i >= 0; --i) {
-      array[--ULL_hist[5][histogram_->ExtractBit(placeholder_array[i], 5)]] =
-          histogram_->FlipFlopInteger(placeholder_array[i]);
+    std::fill(histogram, histogram + 257, 0);
+    for (int i = 0; i < size; ++i) {
+      ++histogram[StringDigit(strings[i], prefixes[i], *depth)];
     }
-  } else {  // Use FlopFloatingPoint.
-    for (int i = size - 1; i >= 0; --i) {
-      array[--ULL_hist[5][histogram_->ExtractBit(placeholder_array[i], 5)]] =
-          histogram_->FlopFloatingPoint(placeholder_array[i]);
+    histogram_->GetPrefixSum(histogram, 257);
+    if (histogram[0] == static_cast<kHistogramDataType>(size)) {
+      return false;  // Every string ended.
+    }
+    if (!histogram_->IsTrivialDigit(histogram, 257, size)) {
+      return true;
     }
+    ++*depth;
   }
 }
 
-template <typename T>
-void RadixSort::Sort(std::vector<T>& array) {
-  // Sort the array.  Expected types all but bool and long double.
-  // Detect if type is unsigned, signed or float for sorting.
-  const bool is_signed = std::numeric_limits<T>::is_signed;
-  const bool is_integer = std::numeric_limits<T>::is_integer;
-  enum SortType type;
-  if (is_signed && is_integer) {  // This is an integer type.
-    type = SIGNED;
-  } else if (is_signed && !is_integer) {  // This is a floating point type.
-    type = FLOAT;
-  } else if (!is_signed && is_integer) {  // This is an unsigned type.
-    type = UNSIGNED;
-  } else {  // Not sure if this will ever be called, but it can't sort this
-            // type.
-    return;
+int RadixSort::StringDigit(const std::string_view string,
+                           const uint64_t prefix, const size_t depth) {
+  // Shorter strings come first, so their digit is below every byte.
+  if (depth >= string.size()) {
+    return 0;
   }
-  switch (sizeof(T)) {
-    case 1:  // All 8 bit types.
-      SortType(reinterpret_cast<uint8_t*>(&array[0]), array.size(), type);
-      break;
+  return ((prefix >> (56 - 8 * (depth % 8))) & 0xFF) + 1;
+}
 
-    case 2:  // All 16 bit types.
-      SortType(reinterpret_cast<uint16_t*>(&array[0]), array.size(), type);
-      break;
+uint64_t RadixSort::LoadPrefix(const std::string_view string,
+                               const size_t depth) {
+  // Bytes past the end are zero, StringDigit checks the length anyway.
+  uint64_t prefix = 0;
+  const size_t end = std::min(string.size(), depth + 8);
+  for (size_t i = depth; i < end; ++i) {
+    prefix |= static_cast<uint64_t>(static_cast<uint8_t>(string[i]))
+              << (56 - 8 * (i - depth));
+  }
+  return prefix;
+}
+#endif
+
+template <size_t N>
+void RadixSort::SortBytes(std::array<uint8_t, N>* array, const int size) {
+  // The last byte is the least significant digit, pass N - 1 - byte.
+  static_assert(N > 0, "Byte keys need at least one byte");
+  typedef std::array<uint8_t, N> Key;
+  if (size == 0) {
+    return;
+  }
+  kHistogramDataType* histogram =
+      histogram_block_.Get<kHistogramDataType>(N * 256);
+  std::fill(histogram, histogram + N * 256, 0);
+  for (int i = 0; i < size; ++i) {
+    for (size_t byte = 0; byte < N; ++byte) {
+      ++histogram[(N - 1 - byte) * 256 + array[i][byte]];
+    }
+  }
+  for (size_t pass = 0; pass < N; ++pass) {
+    histogram_->GetPrefixSum(histogram + pass * 256, 256);
+  }
+  // Bytes shared by every key, e.g. zero padding, skip their passes.
+  int active[N];
+  const int active_passes = GetActivePasses<8>(histogram, N, size, active);
+  Key* source = array;
+  Key* destination = placeholder_.Get<Key>(size);
+  for (int p = 0; p < active_passes; ++p) {
+    const int pass = active[p];
+    const int byte = N - 1 - pass;
+    kHistogramDataType* offset = histogram + pass * 256;
+    if (order_ == DESCENDING) {
+      ReverseOffsets(offset, 256, size);
+    }
+    for (int i = size - 1; i >= 0; --i) {
+      destination[--offset[source[i][byte]]] = source[i];
+    }
+    std::swap(source, destination);
+  }
+  if (source != array) {  // Odd number of passes, copy back.
+    std::copy(source, source + size, array);
+  }
+}
+
+template <size_t N>
+void RadixSort::Sort(std::vector<std::array<uint8_t, N>>& array) {  // NOLINT
+  SortBytes(array.data(), array.size());
+}
+
+template <int kDigitBits, typename T>
+void RadixSort::SortDigits(T* array, const int size, const enum SortType type) {
+  SortDigits<kDigitBits>(array, array, size, type);
+}
+
+template <int kDigitBits, typename T>
+void RadixSort::SortDigits(const T* input, T* array, const int size,
+                           const enum SortType type) {
+  // One flat histogram per digit, then the passes.  With an odd number of
+  // passes the histogram copies the keys into the placeholder, so the last
+  // pass lands in the array instead of being copied back after it.
+  if (size == 0) {
+    return;
+  }
+  const int passes = DigitPasses<kDigitBits, T>();
+  const bool staged = passes % 2 == 1;
+  kHistogramDataType* histogram =
+      histogram_block_.Get<kHistogramDataType>(passes << kDigitBits);
+  {
+    RADIX_SORT_PHASE(stats_, HISTOGRAM_PHASE);
+    if (staged || input != array) {
+      RADIX_SORT_COUNT(stats_, bytes_moved, size * sizeof(T));
+      T* keys = staged ? placeholder_.Get<T>(size) : array;
+      histogram_->GetDigitHistogram<kDigitBits>(input, keys, size, type,
+                                                histogram);
+    } else {
+      histogram_->GetDigitHistogram<kDigitBits>(array, size, type, histogram);
+    }
+  }
+  SortPasses<kDigitBits>(array, size, type, histogram, passes,
+                         order_ == DESCENDING, staged);
+}
+
+template <typename T>
+void RadixSort::SortDigitsFor(const T* input, T* array, const int size,
+                              const enum SortType type) {
+  switch (DigitBitsFor(size, sizeof(*array))) {
+    case 8:
+      SortDigits<8>(input, array, size, type);
+      break;
+    case 16:
+      SortDigits<16>(input, array, size, type);
+      break;
+    default:
+      SortDigits<11>(input, array, size, type);
+  }
+}
+
+template <int kDigitBits, typename T>
+void RadixSort::SortPasses(T* array, const int size, const enum SortType type,
+                           kHistogramDataType* histogram, const int passes,
+                           const bool descending, const bool staged) {
+  // Ping pong between the array and the placeholder, skipping passes where
+  // every element has the same digit and flopping during the last pass.
+  int active[DigitPasses<kDigitBits, T>()];
+  const int active_passes =
+      GetActivePasses<kDigitBits>(histogram, passes, size, active);
+  RADIX_SORT_COUNT(stats_, passes, active_passes);
+  RADIX_SORT_COUNT(stats_, passes_skipped, passes - active_passes);
+  T* source = staged ? placeholder_.Get<T>(size) : array;
+  T* destination = staged ? array : placeholder_.Get<T>(size);
+  if (active_passes == 0) {  // All elements are equal, only flop them back.
+    RADIX_SORT_PHASE(stats_, COPY_PHASE);
+    RADIX_SORT_COUNT(stats_, bytes_moved, size * sizeof(T));
+    if (staged) {
+      std::copy(source, source + size, array);
+    }
+    FlopArray(array, size, type, false);
+    return;
+  }
+  for (int p = 0; p < active_passes; ++p) {
+    RADIX_SORT_PHASE(stats_, SCATTER_PHASE);
+    RADIX_SORT_COUNT(stats_, bytes_moved, size * sizeof(T));
+    const int pass = active[p];
+    const enum SortType flop = p == active_passes - 1 ? type : UNSIGNED;
+    kHistogramDataType* offset = histogram + (pass << kDigitBits);
+    if (descending) {
+      ReverseOffsets(offset, 1 << kDigitBits, size);
+    }
+    Histogram* transforms = histogram_.get();
+    if (scatter_mode_ != DIRECT && flop == UNSIGNED) {
+      BufferedScatter<kDigitBits>(source, destination, size, pass, offset,
+                                  descending,
+                                  [](const T value) { return value; });
+    } else if (scatter_mode_ != DIRECT && flop == SIGNED) {
+      BufferedScatter<kDigitBits>(source, destination, size, pass, offset,
+                                  descending, [transforms](const T value) {
+                                    return transforms->FlipFlopInteger(value);
+                                  });
+    } else if (scatter_mode_ != DIRECT) {
+      BufferedScatter<kDigitBits>(source, destination, size, pass, offset,
+                                  descending, [transforms](const T value) {
+                                    return transforms->FlopFloatingPoint(value);
+                                  });
+    } else if (flop == UNSIGNED) {  // No Flip Flop.
+      for (int i = size - 1; i >= 0; --i) {
+        destination[--offset[histogram_->ExtractDigit<kDigitBits>(
+            source[i], pass)]] = source[i];
+      }
+    } else if (flop == SIGNED) {  // Use FlipFlopInteger.
+      for (int i = size - 1; i >= 0; --i) {
+        destination[--offset[histogram_->ExtractDigit<kDigitBits>(
+            source[i], pass)]] = histogram_->FlipFlopInteger(source[i]);
+      }
+    } else {  // Use FlopFloatingPoint.
+      for (int i = size - 1; i >= 0; --i) {
+        destination[--offset[histogram_->ExtractDigit<kDigitBits>(
+            source[i], pass)]] = histogram_->FlopFloatingPoint(source[i]);
+      }
+    }
+    std::swap(source, destination);
+  }
+  if (source != array) {  // Skipped passes left the keys outside, copy back.
+    RADIX_SORT_PHASE(stats_, COPY_PHASE);
+    RADIX_SORT_COUNT(stats_, bytes_moved, size * sizeof(T));
+    std::copy(source, source + size, array);
+  }
+}
+
+template <int kDigitBits, typename T, typename Transform>
+void RadixSort::BufferedScatter(const T* source, T* destination,
+                                const int size, const int pass,
+                                const kHistogramDataType* offset,
+                                const bool descending, Transform transform) {
+  // Stage every bucket's elements in its own line and write full lines.  The
+  // first line of a bucket starts part way in so later flushes land on
+  // destination cache line boundaries.
+  const int buckets = 1 << kDigitBits;
+  const int line_size = kCacheLineSize / sizeof(T);
+  char* block = line_buffer_.Get<char>(
+      buckets * (kCacheLineSize + sizeof(kHistogramDataType) + 4));
+  T* lines = reinterpret_cast<T*>(block);
+  // Next destination index, first staged slot and slots in use per bucket.
+  kHistogramDataType* heads =
+      reinterpret_cast<kHistogramDataType*>(block + buckets * kCacheLineSize);
+  int16_t* starts = reinterpret_cast<int16_t*>(heads + buckets);
+  int16_t* fills = starts + buckets;
+  for (int digit = 0; digit < buckets; ++digit) {
+    if (descending) {  // Buckets from the highest digit down.
+      heads[digit] = digit == buckets - 1 ? 0 : offset[digit + 1];
+    } else {
+      heads[digit] = digit == 0 ? 0 : offset[digit - 1];
+    }
+    const uintptr_t address =
+        reinterpret_cast<uintptr_t>(destination + heads[digit]);
+    starts[digit] = (address % kCacheLineSize) / sizeof(T);
+    fills[digit] = starts[digit];
+  }
+  for (int i = 0; i < size; ++i) {
+    const int digit = histogram_->ExtractDigit<kDigitBits>(source[i], pass);
+    T* line = lines + digit * line_size;
+    line[fills[digit]++] = transform(source[i]);
+    if (fills[digit] == line_size) {
+      const int count = line_size - starts[digit];
+      FlushLine(line + starts[digit], destination + heads[digit], count);
+      heads[digit] += count;
+      starts[digit] = 0;
+      fills[digit] = 0;
+    }
+  }
+  for (int digit = 0; digit < buckets; ++digit) {  // Partially filled lines.
+    std::memcpy(destination + heads[digit],
+                lines + digit * line_size + starts[digit],
+                (fills[digit] - starts[digit]) * sizeof(T));
+  }
+#ifdef HISTOGRAM_HAS_X86_SIMD
+  if (scatter_mode_ == STREAMING) {  // Order the streaming stores.
+    _mm_sfence();
+  }
+#endif
+}
+
+template <typename T>
+void RadixSort::FlushLine(const T* line, T* destination, const int count) {
+  // Non-temporal stores for STREAMING where available, memcpy otherwise.
+#ifdef HISTOGRAM_HAS_X86_SIMD
+  if (scatter_mode_ == STREAMING && sizeof(T) == 8) {
+    for (int i = 0; i < count; ++i) {
+      long long value;  // NOLINT
+      std::memcpy(&value, line + i, sizeof(value));
+      _mm_stream_si64(reinterpret_cast<long long*>(destination + i),  // NOLINT
+                      value);
+    }
+    return;
+  }
+  if (scatter_mode_ == STREAMING && sizeof(T) == 4) {
+    for (int i = 0; i < count; ++i) {
+      int value;
+      std::memcpy(&value, line + i, sizeof(value));
+      _mm_stream_si32(reinterpret_cast<int*>(destination + i), value);
+    }
+    return;
+  }
+#endif
+  std::memcpy(destination, line, count * sizeof(T));
+}
+
+template <int kDigitBits>
+int RadixSort::GetActivePasses(const kHistogramDataType* histogram,
+                               const int passes, const int size, int* active) {
+  // Passes where every element has the same digit don't move anything.
+  const int buckets = 1 << kDigitBits;
+  int active_passes = 0;
+  for (int pass = 0; pass < passes; ++pass) {
+    if (!histogram_->IsTrivialDigit(histogram + pass * buckets, buckets,
+                                    size)) {
+      active[active_passes++] = pass;
+    }
+  }
+  return active_passes;
+}
+
+void RadixSort::ReverseOffsets(kHistogramDataType* offset, const int buckets,
+                               const int size) {
+  // Bucket digit ends where the buckets of the digits above it start.
+  for (int digit = buckets - 1; digit > 0; --digit) {
+    offset[digit] = size - offset[digit - 1];
+  }
+  offset[0] = size;
+}
+
+template <typename T>
+void RadixSort::FlipArray(T* array, const int size, const enum SortType type,
+                          const bool invert) {
+  // Order signed and floating point bits like unsigned values.
+  const T mask = invert ? static_cast<T>(~T(0)) : T(0);
+  if (type == SIGNED) {  // Use FlipFlopInteger.
+    for (int i = 0; i < size; ++i) {
+      array[i] = histogram_->FlipFlopInteger(array[i]) ^ mask;
+    }
+  } else if (type == FLOAT) {  // Use FlipFloatingPoint.
+    for (int i = 0; i < size; ++i) {
+      array[i] = histogram_->FlipFloatingPoint(array[i]) ^ mask;
+    }
+  } else if (invert) {
+    for (int i = 0; i < size; ++i) {
+      array[i] = ~array[i];
+    }
+  }
+}
+
+template <typename T>
+void RadixSort::InPlaceSortType(T* array, const int size,
+                                const enum SortType type) {
+  // Sort with nothing but the histograms as extra memory.
+  if (size == 0 || (sizeof(T) <= 2 && type == FLOAT)) {
+    return;
+  }
+  if (sizeof(T) <= 2) {
+    // Small types are counted and written back from the histogram.
+    const int buckets = std::numeric_limits<T>::max() + 1;
+    kHistogramDataType* T_hist =
+        histogram_block_.Get<kHistogramDataType>(buckets);
+    histogram_->GetHistogram(array, size, type, T_hist);
+    kHistogramDataType start = 0;
+    for (int i = 0; i < buckets; ++i) {
+      const int value = order_ == DESCENDING ? buckets - 1 - i : i;
+      const T flopped =
+          type == UNSIGNED ? value : histogram_->FlipFlopInteger(T(value));
+      const kHistogramDataType count =
+          T_hist[value] - (value == 0 ? 0 : T_hist[value - 1]);
+      std::fill(array + start, array + start + count, flopped);
+      start += count;
+    }
+    return;
+  }
+  const int passes = sizeof(T) == 4 ? 3 : 6;
+  kHistogramDataType* levels =
+      histogram_block_.Get<kHistogramDataType>(passes * 2 * 2048);
+  FlipArray(array, size, type, order_ == DESCENDING);
+  AmericanFlagSort(array, size, passes - 1, levels);
+  FlopArray(array, size, type, order_ == DESCENDING);
+}
+
+template <typename T>
+void RadixSort::AmericanFlagSort(T* array, const int size, const int pass,
+                                 kHistogramDataType* levels) {
+  // Partition on the digit, then recurse into the buckets.
+  if (size <= insertion_sort_size_) {
+    InsertionSort(array, size);
+    return;
+  }
+  kHistogramDataType* heads = levels + pass * 2 * 2048;
+  kHistogramDataType* ends = heads + 2048;
+  PartitionDigit(array, size, pass, heads, ends);
+  if (pass == 0) {
+    return;
+  }
+  kHistogramDataType start = 0;
+  for (int digit = 0; digit < 2048; ++digit) {
+    if (ends[digit] - start > 1) {
+      AmericanFlagSort(array + start, ends[digit] - start, pass - 1, levels);
+    }
+    start = ends[digit];
+  }
+}
+
+template <typename T>
+void RadixSort::PartitionDigit(T* array, const int size, const int pass,
+                               kHistogramDataType* heads,
+                               kHistogramDataType* ends) {
+  // Permute every element into its bucket by following cycles.
+  std::fill(ends, ends + 2048, 0);
+  histogram_->CountDigit(array, 0, size, pass, ends);
+  histogram_->GetPrefixSum(ends, 2048);
+  if (histogram_->IsTrivialDigit(ends, 2048, size)) {
+    return;
+  }
+  heads[0] = 0;
+  std::copy(ends, ends + 2047, heads + 1);
+  for (int digit = 0; digit < 2048; ++digit) {
+    while (heads[digit] < ends[digit]) {
+      T value = array[heads[digit]];
+      int value_digit = histogram_->ExtractBit(value, pass);
+      while (value_digit != digit) {  // Swap value into its own bucket.
+        std::swap(value, array[heads[value_digit]++]);
+        value_digit = histogram_->ExtractBit(value, pass);
+      }
+      array[heads[digit]++] = value;
+    }
+  }
+}
+
+template <typename T>
+void RadixSort::HybridSortType(T* array, const int size,
+                               const enum SortType type) {
+  // Skip the histograms for small arrays, otherwise split on the top digit and
+  // pick a sort for every bucket.
+  if (size == 0 || (sizeof(T) <= 2 && type == FLOAT)) {
+    return;
+  }
+  if (size <= comparison_sort_size_) {
+    FlipArray(array, size, type, order_ == DESCENDING);
+    SmallSort(array, size);
+    FlopArray(array, size, type, order_ == DESCENDING);
+    return;
+  }
+  if (sizeof(T) <= 2) {  // A single counting pass, nothing to split.
+    SortType(array, size, type);
+    return;
+  }
+  const int passes = sizeof(T) == 4 ? 3 : 6;
+  // Top digit heads and ends, then the flat histograms of a bucket.
+  kHistogramDataType* block =
+      histogram_block_.Get<kHistogramDataType>((2 + passes) * 2048);
+  kHistogramDataType* heads = block;
+  kHistogramDataType* ends = block + 2048;
+  kHistogramDataType* bucket_hist = block + 2 * 2048;
+  FlipArray(array, size, type, order_ == DESCENDING);
+  PartitionDigit(array, size, passes - 1, heads, ends);
+  kHistogramDataType start = 0;
+  for (int digit = 0; digit < 2048; ++digit) {
+    T* bucket = array + start;
+    const int bucket_size = ends[digit] - start;
+    start = ends[digit];
+    if (bucket_size <= comparison_sort_size_) {
+      SmallSort(bucket, bucket_size);
+    } else {  // LSD on the lower digits, the top one is trivial by now.
+      histogram_->GetHistogram(bucket, bucket_size, UNSIGNED, bucket_hist);
+      SortPasses<11>(bucket, bucket_size, UNSIGNED, bucket_hist, passes - 1,
+                     false, false);
+    }
+  }
+  FlopArray(array, size, type, order_ == DESCENDING);
+}
+
+template <typename T>
+T RadixSort::Select(std::vector<T>& array, const int k) {  // NOLINT
+  if (array.empty()) {
+    return T();
+  }
+  const int nth = std::max(0, std::min<int>(k, array.size() - 1));
+  SelectArray(array.data(), array.size(), nth, false);
+  return array[nth];
+}
+
+template <typename T>
+void RadixSort::PartialSort(std::vector<T>& array, const int k) {  // NOLINT
+  // The k-th element goes in place and everything before it is sorted.
+  if (k <= 0) {
+    return;
+  }
+  SelectArray(array.data(), array.size(),
+              std::min<int>(k, array.size()) - 1, true);
+}
+
+template <typename T>
+std::vector<T> RadixSort::TopK(const std::vector<T>& array, const int k) {
+  // Partially sort a copy.
+  const int count = std::max(0, std::min<int>(k, array.size()));
+  std::vector<T> top(array);
+  PartialSort(top, count);
+  top.resize(count);
+  return top;
+}
+
+template <typename T>
+void RadixSort::SelectArray(T* array, const int size, const int nth,
+                            const bool sort_prefix) {
+  // Detect the key type and select based on its bit structure.
+  enum SortType type;
+  if (nth < 0 || nth >= size || !DetectSortType<T>(&type)) {
+    return;
+  }
+  switch (sizeof(T)) {
+    case 1:  // All 8 bit types.
+      SelectType(reinterpret_cast<uint8_t*>(array), size, nth, type,
+                 sort_prefix);
+      break;
+
+    case 2:  // All 16 bit types.
+      SelectType(reinterpret_cast<uint16_t*>(array), size, nth, type,
+                 sort_prefix);
+      break;
+
+    case 4:  // All 32 bit types.
+      SelectType(reinterpret_cast<uint32_t*>(array), size, nth, type,
+                 sort_prefix);
+      break;
+
+    case 8:  // All 64 bit types.
+      SelectType(reinterpret_cast<uint64_t*>(array), size, nth, type,
+                 sort_prefix);
+      break;
+
+    default:  // Can't handle this case.
+      return;
+  }
+}
+
+template <typename T>
+void RadixSort::SelectType(T* array, const int size, const int nth,
+                           const enum SortType type, const bool sort_prefix) {
+  // Flipped (and inverted if descending) values select and sort like
+  // unsigned ones.
+  const bool invert = order_ == DESCENDING;
+  const T mask = invert ? static_cast<T>(~T(0)) : T(0);
+  Histogram* transforms = histogram_.get();
+  if (type == SIGNED) {
+    SelectDigits(array, size, nth, [transforms, mask](const T value) {
+      return static_cast<T>(transforms->FlipFlopInteger(value) ^ mask);
+    });
+  } else if (type == FLOAT) {
+    SelectDigits(array, size, nth, [transforms, mask](const T value) {
+      return static_cast<T>(transforms->FlipFloatingPoint(value) ^ mask);
+    });
+  } else {
+    SelectDigits(array, size, nth, [mask](const T value) {
+      return static_cast<T>(value ^ mask);
+    });
+  }
+  if (!sort_prefix) {
+    return;
+  }
+  FlipArray(array, nth, type, invert);
+  if (nth <= comparison_sort_size_) {
+    SmallSort(array, nth);
+  } else {
+    const int passes = DigitPasses<11, T>();
+    kHistogramDataType* histogram =
+        histogram_block_.Get<kHistogramDataType>(passes * 2048);
+    histogram_->GetDigitHistogram<11>(array, nth, UNSIGNED, histogram);
+    SortPasses<11>(array, nth, UNSIGNED, histogram, passes, false, false);
+  }
+  FlopArray(array, nth, type, invert);
+}
+
+template <typename T, typename Transform>
+void RadixSort::SelectDigits(T* array, const int size, int nth,
+                             Transform transform) {
+  // Count the digit over the current range, split it into the values below,
+  // in and above nth's bucket and continue with that bucket on the next
+  // digit down.  Once every digit is used up the bucket's values are equal.
+  kHistogramDataType counts[2048];
+  T* range = array;
+  int range_size = size;
+  for (int pass = DigitPasses<11, T>() - 1; pass >= 0 && range_size > 1;
+       --pass) {
+    std::fill(counts, counts + 2048, 0);
+    for (int i = 0; i < range_size; ++i) {
+      ++counts[histogram_->ExtractBit(transform(range[i]), pass)];
+    }
+    int digit = 0;
+    int below = 0;
+    while (below + static_cast<int>(counts[digit]) <= nth) {
+      below += counts[digit++];
+    }
+    const int bucket = counts[digit];
+    if (bucket != range_size) {
+      // Move the bucket and the ones below it to the front, then the ones
+      // below it further ahead.  Only those elements are written, few of
+      // them when nth is small.
+      int front = 0;
+      for (int i = 0; front < below + bucket; ++i) {
+        if (histogram_->ExtractBit(transform(range[i]), pass) <= digit) {
+          std::swap(range[front++], range[i]);
+        }
+      }
+      front = 0;
+      for (int i = 0; front < below; ++i) {
+        if (histogram_->ExtractBit(transform(range[i]), pass) < digit) {
+          std::swap(range[front++], range[i]);
+        }
+      }
+    }
+    range += below;
+    range_size = bucket;
+    nth -= below;
+  }
+}
+
+template <typename T>
+void RadixSort::SmallSort(T* array, const int size) {
+  // Insertion sort wins below insertion_sort_size_.
+  if (size <= insertion_sort_size_) {
+    InsertionSort(array, size);
+  } else {
+    std::sort(array, array + size);
+  }
+}
+
+template <typename T>
+void RadixSort::InsertionSort(T* array, const int size) {
+  // Flipped values compare like unsigned values.
+  for (int i = 1; i < size; ++i) {
+    const T value = array[i];
+    int j = i;
+    for (; j > 0 && array[j - 1] > value; --j) {
+      array[j] = array[j - 1];
+    }
+    array[j] = value;
+  }
+}
+
+template <typename T>
+void RadixSort::SortWithStrategy(T* array, const int size,
+                                 const enum SortType type) {
+  // Dispatch on the strategy, SortType checks for presorted input itself.
+  if (strategy_ != LSD && sizeof(T) >= 4 &&
+      SortPresorted(array, size, type)) {
+    return;
+  }
+  if (strategy_ == IN_PLACE_MSD) {
+    InPlaceSortType(array, size, type);
+  } else if (strategy_ == HYBRID) {
+    HybridSortType(array, size, type);
+  } else {
+    SortType(array, size, type);
+  }
+}
+
+template <typename T>
+bool RadixSort::SortPresorted(T* array, const int size,
+                              const enum SortType type) {
+  // Compare the keys the radix sort would sort by.
+  if (presorted_runs_ == 0 || size < 2) {
+    return size < 2;
+  }
+  const T mask = order_ == DESCENDING ? static_cast<T>(~T(0)) : T(0);
+  Histogram* transforms = histogram_.get();
+  if (type == SIGNED) {
+    return SortPresortedKeys(array, size, [transforms, mask](const T value) {
+      return static_cast<T>(transforms->FlipFlopInteger(value) ^ mask);
+    });
+  } else if (type == FLOAT) {
+    return SortPresortedKeys(array, size, [transforms, mask](const T value) {
+      return static_cast<T>(transforms->FlipFloatingPoint(value) ^ mask);
+    });
+  }
+  return SortPresortedKeys(array, size, [mask](const T value) {
+    return static_cast<T>(value ^ mask);
+  });
+}
+
+template <typename T, typename Transform>
+bool RadixSort::SortPresortedKeys(T* array, const int size,
+                                  Transform transform) {
+  // Note where every ascending run starts.  Past presorted_runs_ runs only
+  // reversed input is still worth scanning for, and once some key has also
+  // gone up it isn't that either.
+  int starts[kMaxPresortedRuns + 2];
+  int runs = 1;
+  starts[0] = 0;
+  bool ascends = false;
+  T previous = transform(array[0]);
+  for (int i = 1; i < size; ++i) {
+    const T key = transform(array[i]);
+    if (key < previous) {
+      if (runs < presorted_runs_) {
+        starts[runs] = i;
+      } else if (ascends) {
+        return false;
+      }
+      ++runs;
+    } else if (key > previous) {
+      if (runs > presorted_runs_) {
+        return false;
+      }
+      ascends = true;
+    }
+    previous = key;
+  }
+  if (runs == 1) {  // Already sorted.
+    return true;
+  }
+  if (!ascends) {  // Non-increasing, equal keys are equal values.
+    std::reverse(array, array + size);
+    return true;
+  }
+
+  // Merge neighbouring runs until one is left, ping ponging between the
+  // array and the placeholder like the passes do.
+  auto less = [transform](const T a, const T b) {
+    return transform(a) < transform(b);
+  };
+  T* source = array;
+  T* destination = placeholder_.Get<T>(size);
+  starts[runs] = size;
+  while (runs > 1) {
+    int merged = 0;
+    for (int run = 0; run < runs; run += 2) {
+      T* begin = source + starts[run];
+      if (run + 1 < runs) {
+        std::merge(begin, source + starts[run + 1], source + starts[run + 1],
+                   source + starts[run + 2], destination + starts[run], less);
+      } else {
+        std::copy(begin, source + starts[run + 1], destination + starts[run]);
+      }
+      starts[merged++] = starts[run];
+    }
+    starts[merged] = size;
+    runs = merged;
+    std::swap(source, destination);
+  }
+  if (source != array) {
+    std::copy(source, source + size, array);
+  }
+  return true;
+}
+
+template <typename T>
+void RadixSort::FlopArray(T* array, const int size, const enum SortType type,
+                          const bool invert) {
+  // Undo the flip applied while building the histogram or by FlipArray.
+  const T mask = invert ? static_cast<T>(~T(0)) : T(0);
+  if (type == SIGNED) {  // Use FlipFlopInteger.
+    for (int i = 0; i < size; ++i) {
+      array[i] = histogram_->FlipFlopInteger(static_cast<T>(array[i] ^ mask));
+    }
+  } else if (type == FLOAT) {  // Use FlopFloatingPoint.
+    for (int i = 0; i < size; ++i) {
+      array[i] =
+          histogram_->FlopFloatingPoint(static_cast<T>(array[i] ^ mask));
+    }
+  } else if (invert) {
+    for (int i = 0; i < size; ++i) {
+      array[i] = ~array[i];
+    }
+  }
+}
+
+template <typename T>
+void RadixSort::ParallelSortType(T* array, const int size,
+                                 const enum SortType type, const int passes) {
+  // Sort 32 and 64-bit data types on up to num_threads_ threads.
+  const int num_threads =
+      std::min(num_threads_, std::max(1, size / kMinElementsPerThread));
+  const int chunk = (size + num_threads - 1) / num_threads;
+  // offsets[thread * 2048 + digit], counts first and then scatter offsets.
+  kHistogramDataType* offsets =
+      histogram_block_.Get<kHistogramDataType>(num_threads * 2048);
+  T* source = array;
+  T* destination = placeholder_.Get<T>(size);
+  bool flopped = false;
+  for (int pass = 0; pass < passes; ++pass) {
+    {
+      RADIX_SORT_PHASE(stats_, HISTOGRAM_PHASE);
+      RunParallel(num_threads, [&](const int thread) {
+        const int begin = std::min(size, thread * chunk);
+        const int end = std::min(size, begin + chunk);
+        kHistogramDataType* counts = &offsets[thread * 2048];
+        std::fill(counts, counts + 2048, 0);
+        if (pass == 0 && type == SIGNED) {  // Flip the chunk before counting.
+          for (int i = begin; i < end; ++i) {
+            source[i] = histogram_->FlipFlopInteger(source[i]);
+          }
+        } else if (pass == 0 && type == FLOAT) {
+          for (int i = begin; i < end; ++i) {
+            source[i] = histogram_->FlipFloatingPoint(source[i]);
+          }
+        }
+        histogram_->CountDigit(source, begin, end, pass, counts);
+      });
+    }
+    // Exclusive prefix sum over digits, then threads, keeps each thread's
+    // elements behind those of the threads before it in the same bucket.
+    // Descending sorts walk the digits from the top.
+    RADIX_SORT_PHASE(stats_, PREFIX_SUM_PHASE);
+    kHistogramDataType sum = 0;
+    bool trivial = false;
+    for (int i = 0; i < 2048; ++i) {
+      const int digit = order_ == DESCENDING ? 2047 - i : i;
+      const kHistogramDataType digit_start = sum;
+      for (int thread = 0; thread < num_threads; ++thread) {
+        const kHistogramDataType count = offsets[thread * 2048 + digit];
+        offsets[thread * 2048 + digit] = sum;
+        sum += count;
+      }
+      trivial |= sum - digit_start == static_cast<kHistogramDataType>(size);
+    }
+    if (trivial) {  // Every element has the same digit, skip the scatter.
+      RADIX_SORT_COUNT(stats_, passes_skipped, 1);
+      continue;
+    }
+    // The last pass flops the values back while scattering them.
+    const enum SortType flop = pass == passes - 1 ? type : UNSIGNED;
+    flopped |= flop != UNSIGNED;
+    RADIX_SORT_PHASE(stats_, SCATTER_PHASE);
+    RADIX_SORT_COUNT(stats_, passes, 1);
+    RADIX_SORT_COUNT(stats_, bytes_moved, size * sizeof(T));
+    RunParallel(num_threads, [&](const int thread) {
+      const int begin = std::min(size, thread * chunk);
+      const int end = std::min(size, begin + chunk);
+      kHistogramDataType* offset = &offsets[thread * 2048];
+      if (flop == UNSIGNED) {  // No Flip Flop.
+        for (int i = begin; i < end; ++i) {
+          destination[offset[histogram_->ExtractBit(source[i], pass)]++] =
+              source[i];
+        }
+      } else if (flop == SIGNED) {  // Use FlipFlopInteger.
+        for (int i = begin; i < end; ++i) {
+          destination[offset[histogram_->ExtractBit(source[i], pass)]++] =
+              histogram_->FlipFlopInteger(source[i]);
+        }
+      } else {  // Use FlopFloatingPoint.
+        for (int i = begin; i < end; ++i) {
+          destination[offset[histogram_->ExtractBit(source[i], pass)]++] =
+              histogram_->FlopFloatingPoint(source[i]);
+        }
+      }
+    });
+    std::swap(source, destination);
+  }
+  // Copy back after an odd number of passes, and flop if the last pass was
+  // skipped.
+  const bool needs_flop = !flopped && type != UNSIGNED;
+  if (source != array || needs_flop) {
+    RADIX_SORT_PHASE(stats_, COPY_PHASE);
+    RADIX_SORT_COUNT(stats_, bytes_moved, size * sizeof(T));
+    RunParallel(num_threads, [&](const int thread) {
+      const int begin = std::min(size, thread * chunk);
+      const int end = std::min(size, begin + chunk);
+      if (source != array) {
+        std::copy(source + begin, source + end, array + begin);
+      }
+      if (needs_flop) {
+        FlopArray(array + begin, end - begin, type, false);
+      }
+    });
+  }
+}
+
+template <typename T>
+void RadixSort::NumaSortType(T* array, const int size,
+                             const enum SortType type) {
+  // Partition the keys by their top digit into one contiguous key range per
+  // node, in a buffer on that node, then sort every range with a sorter on
+  // threads pinned to its node and copy it back into place.  Only the
+  // partitioning scatter and the copy back cross nodes.
+  const int nodes = numa_topology_->nodes();
+  const int num_threads = std::max(
+      nodes, std::min(num_threads_, std::max(1, size / kMinElementsPerThread)));
+  std::vector<int> worker_nodes(num_threads);
+  std::vector<int> node_threads(nodes, 0);
+  for (int worker = 0; worker < num_threads; ++worker) {
+    worker_nodes[worker] = worker * nodes / num_threads;
+    ++node_threads[worker_nodes[worker]];
+  }
+  const int chunk = (size + num_threads - 1) / num_threads;
+  const int shift = 8 * sizeof(T) - 11;
+  const T mask = order_ == DESCENDING ? static_cast<T>(~T(0)) : T(0);
+  Histogram* transforms = histogram_.get();
+  auto top_digit = [transforms, type, mask, shift](const T value) {
+    T key = value;
+    if (type == SIGNED) {
+      key = transforms->FlipFlopInteger(value);
+    } else if (type == FLOAT) {
+      key = transforms->FlipFloatingPoint(value);
+    }
+    return static_cast<int>(static_cast<T>(key ^ mask) >> shift);
+  };
+
+  // Top digit counts per worker, offsets[worker * 2048 + digit].  Nothing
+  // has moved yet, so threads that can't be pinned fall back to the plain
+  // parallel sort.
+  kHistogramDataType* offsets =
+      histogram_block_.Get<kHistogramDataType>(num_threads * 2048);
+  bool pinned;
+  {
+    RADIX_SORT_PHASE(stats_, HISTOGRAM_PHASE);
+    pinned = RunOnNodes(worker_nodes, [&](const int worker) {
+      const int begin = std::min(size, worker * chunk);
+      const int end = std::min(size, begin + chunk);
+      kHistogramDataType* counts = &offsets[worker * 2048];
+      std::fill(counts, counts + 2048, 0);
+      for (int i = begin; i < end; ++i) {
+        ++counts[top_digit(array[i])];
+      }
+    });
+  }
+  if (!pinned) {
+    ParallelSortType(array, size, type, (8 * sizeof(T) + 10) / 11);
+    return;
+  }
+
+  // Give every node a run of whole digits holding about size / nodes keys,
+  // then turn the counts into each worker's offsets within its nodes'
+  // buffers, keeping equal keys in input order.
+  std::vector<int> digit_node(2048);
+  std::vector<kHistogramDataType> node_size(nodes, 0);
+  {
+    RADIX_SORT_PHASE(stats_, PREFIX_SUM_PHASE);
+    kHistogramDataType total = 0;
+    for (int digit = 0; digit < 2048; ++digit) {
+      const int node =
+          std::min<kHistogramDataType>(nodes - 1, total * nodes / size);
+      digit_node[digit] = node;
+      for (int worker = 0; worker < num_threads; ++worker) {
+        const kHistogramDataType count = offsets[worker * 2048 + digit];
+        offsets[worker * 2048 + digit] = node_size[node];
+        node_size[node] += count;
+        total += count;
+      }
+    }
+  }
+  // Grow the node buffers kept from earlier sorts if they are too small.
+  node_buffers_.resize(nodes);
+  std::vector<bool> fresh(nodes, false);
+  for (int node = 0; node < nodes; ++node) {
+    const size_t bytes = node_size[node] * sizeof(T);
+    if (node_buffers_[node] == nullptr ||
+        node_buffers_[node]->bytes() < bytes) {
+      node_buffers_[node].reset(nullptr);  // Free it before allocating.
+      node_buffers_[node].reset(new NodeBuffer(*numa_topology_, node, bytes));
+      ++node_allocations_;
+      fresh[node] = true;
+    }
+  }
+  const std::vector<std::unique_ptr<NodeBuffer>>& buffers = node_buffers_;
+
+  // Touch every new buffer from its own node first, so its pages land there
+  // even without libnuma, then scatter into them.
+  RADIX_SORT_PHASE(stats_, SCATTER_PHASE);
+  RADIX_SORT_COUNT(stats_, passes, 1);
+  RADIX_SORT_COUNT(stats_, bytes_moved, 2 * size * sizeof(T));
+  std::vector<int> node_rank(num_threads);
+  for (int worker = 1; worker < num_threads; ++worker) {
+    node_rank[worker] = worker_nodes[worker] == worker_nodes[worker - 1]
+                            ? node_rank[worker - 1] + 1
+                            : 0;
+  }
+  RunOnNodes(worker_nodes, [&](const int worker) {
+    const int node = worker_nodes[worker];
+    if (!fresh[node]) {
+      return;
+    }
+    const size_t share =
+        (node_size[node] + node_threads[node] - 1) / node_threads[node];
+    const size_t begin = std::min<size_t>(node_size[node],
+                                          node_rank[worker] * share);
+    const size_t end = std::min<size_t>(node_size[node], begin + share);
+    T* buffer = buffers[node]->Get<T>();
+    for (size_t i = begin; i < end; i += kPageBytes / sizeof(T)) {
+      buffer[i] = T(0);
+    }
+  });
+  RunOnNodes(worker_nodes, [&](const int worker) {
+    const int begin = std::min(size, worker * chunk);
+    const int end = std::min(size, begin + chunk);
+    kHistogramDataType* offset = &offsets[worker * 2048];
+    for (int i = begin; i < end; ++i) {
+      const int digit = top_digit(array[i]);
+      buffers[digit_node[digit]]->Get<T>()[offset[digit]++] = array[i];
+    }
+  });
+
+  // Sort every node's range on its own node with the node's sorter, threads
+  // started by a pinned thread inherit its CPUs, and copy it back.  A sorter
+  // is created by its node's leader, so its scratch memory is first touched
+  // on the node.
+  std::vector<int> leaders(nodes);
+  for (int node = 0; node < nodes; ++node) {
+    leaders[node] = node;
+  }
+  node_sorters_.resize(nodes);
+  RunOnNodes(leaders, [&](const int node) {
+    const int node_keys = node_size[node];
+    if (node_keys == 0) {
+      return;
+    }
+    if (node_sorters_[node] == nullptr) {
+      node_sorters_[node].reset(new RadixSort);
+    }
+    RadixSort& sorter = *node_sorters_[node];
+    sorter.set_num_threads(node_threads[node]);
+    sorter.CopySettings(*this);
+    T* buffer = buffers[node]->Get<T>();
+    sorter.SortType(buffer, node_keys, type);
+    kHistogramDataType start = 0;
+    for (int other = 0; other < node; ++other) {
+      start += node_size[other];
+    }
+    const int copy_chunk =
+        (node_keys + node_threads[node] - 1) / node_threads[node];
+    sorter.RunParallel(node_threads[node], [&](const int thread) {
+      const int begin = std::min(node_keys, thread * copy_chunk);
+      const int end = std::min(node_keys, begin + copy_chunk);
+      std::copy(buffer + begin, buffer + end, array + start + begin);
+    });
+  });
+}
+
+template <typename Function>
+bool RadixSort::RunOnNodes(const std::vector<int>& worker_nodes,
+                           Function function) {
+  std::vector<std::thread> threads;
+  std::atomic<bool> pinned(true);
+  threads.reserve(worker_nodes.size());
+  for (size_t worker = 0; worker < worker_nodes.size(); ++worker) {
+    threads.emplace_back([this, &worker_nodes, &function, &pinned, worker]() {
+      if (!numa_topology_->PinThread(worker_nodes[worker])) {
+        pinned = false;
+      }
+      function(worker);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return pinned;
+}
+
+template <typename Function>
+void RadixSort::RunParallel(const int num_threads, Function function) {
+  // Thread 0 runs on the calling thread.
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (int thread = 1; thread < num_threads; ++thread) {
+    threads.emplace_back(function, thread);
+  }
+  function(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+template <typename T, typename V>
+void RadixSort::SortPairsType(T* keys, V* values, const int size,
+                              const enum SortType type) {
+  // Sort all 8 and 16-bit keys with their values in a single pass.
+  if (size == 0 || type == FLOAT) {
+    return;
+  }
+  kHistogramDataType* T_hist = histogram_block_.Get<kHistogramDataType>(
+      std::numeric_limits<T>::max() + 1);
+  histogram_->GetHistogram(keys, size, type, T_hist);
+  if (order_ == DESCENDING) {
+    ReverseOffsets(T_hist, std::numeric_limits<T>::max() + 1, size);
+  }
+  T* placeholder_keys = placeholder_.Get<T>(size);
+  std::vector<V> fallback;
+  V* placeholder_values = GetValueScratch(size, &fallback);
+  for (int i = size - 1; i >= 0; --i) {
+    const kHistogramDataType index = --T_hist[keys[i]];
+    placeholder_keys[index] = keys[i];
+    placeholder_values[index] = values[i];
+  }
+  for (int i = 0; i < size; ++i) {
+    keys[i] = type == UNSIGNED
+                  ? placeholder_keys[i]
+                  : histogram_->FlipFlopInteger(placeholder_keys[i]);
+    values[i] = placeholder_values[i];
+  }
+}
+
+template <typename V>
+void RadixSort::SortPairsType(uint32_t* keys, V* values, const int size,
+                              const enum SortType type) {
+  // Sort all 32-bit keys with their values in 3 passes.
+  if (size == 0) {
+    return;
+  }
+  kHistogramDataType* int_hist =
+      histogram_block_.Get<kHistogramDataType>(3 * 2048);
+  histogram_->GetHistogram(keys, size, type, int_hist);
+  SortPairsPasses(keys, values, size, type, int_hist, 3);
+}
+
+template <typename V>
+void RadixSort::SortPairsType(uint64_t* keys, V* values, const int size,
+                              const enum SortType type) {
+  // Sort all 64-bit keys with their values in 6 passes.
+  if (size == 0) {
+    return;
+  }
+  kHistogramDataType* ULL_hist =
+      histogram_block_.Get<kHistogramDataType>(6 * 2048);
+  histogram_->GetHistogram(keys, size, type, ULL_hist);
+  SortPairsPasses(keys, values, size, type, ULL_hist, 6);
+}
+
+template <typename T, typename V>
+void RadixSort::SortPairsPasses(T* keys, V* values, const int size,
+                                const enum SortType type,
+                                kHistogramDataType* histogram,
+                                const int passes) {
+  // Ping pong keys and values between the arrays and placeholders, skipping
+  // trivial passes and flopping the keys back on the last pass.
+  int active[6];
+  const int active_passes =
+      GetActivePasses<11>(histogram, passes, size, active);
+  if (active_passes == 0) {  // All keys are equal, only flop them back.
+    FlopArray(keys, size, type, false);
+    return;
+  }
+  std::vector<V> fallback;
+  T* source_keys = keys;
+  V* source_values = values;
+  T* destination_keys = placeholder_.Get<T>(size);
+  V* destination_values = GetValueScratch(size, &fallback);
+  for (int p = 0; p < active_passes; ++p) {
+    const int pass = active[p];
+    const enum SortType flop = p == active_passes - 1 ? type : UNSIGNED;
+    kHistogramDataType* offset = histogram + pass * 2048;
+    if (order_ == DESCENDING) {
+      ReverseOffsets(offset, 2048, size);
+    }
+    for (int i = size - 1; i >= 0; --i) {
+      const T key = source_keys[i];
+      const kHistogramDataType index =
+          --offset[histogram_->ExtractBit(key, pass)];
+      if (flop == UNSIGNED) {  // No Flip Flop.
+        destination_keys[index] = key;
+      } else if (flop == SIGNED) {  // Use FlipFlopInteger.
+        destination_keys[index] = histogram_->FlipFlopInteger(key);
+      } else {  // Use FlopFloatingPoint.
+        destination_keys[index] = histogram_->FlopFloatingPoint(key);
+      }
+      destination_values[index] = source_values[i];
+    }
+    std::swap(source_keys, destination_keys);
+    std::swap(source_values, destination_values);
+  }
+  if (source_keys != keys) {  // Odd number of passes, copy back.
+    std::copy(source_keys, source_keys + size, keys);
+    std::copy(source_values, source_values + size, values);
+  }
+}
+
+template <typename T, typename I>
+std::vector<I> RadixSort::ArgSort(const std::vector<T>& array) {
+  // Sort a copy of the keys with their indices as the values.
+  std::vector<I> indices(array.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    indices[i] = i;
+  }
+  T* keys = key_copy_.Get<T>(array.size());
+  std::copy(array.begin(), array.end(), keys);
+  SortPairsArray(keys, indices.data(), array.size());
+  return indices;
+}
+
+template <typename R, typename KeyFunction>
+void RadixSort::SortByKey(R* records, const int size, KeyFunction key) {
+  // Cache the keys, then sort small records with them directly and large
+  // ones through their indices.
+  typedef typename std::decay<decltype(key(*records))>::type K;
+  K* keys = key_copy_.Get<K>(size);
+  for (int i = 0; i < size; ++i) {
+    keys[i] = key(records[i]);
+  }
+  if (std::is_trivially_copyable<R>::value &&
+      sizeof(R) <= kMaxDirectRecordSize) {
+    SortPairsArray(keys, records, size);
+    return;
+  }
+  uint32_t* indices = record_indices_.Get<uint32_t>(size);
+  for (int i = 0; i < size; ++i) {
+    indices[i] = i;
+  }
+  SortPairsArray(keys, indices, size);
+  ApplyPermutation(records, indices, size);
+}
+
+template <typename R, typename KeyFunction>
+void RadixSort::SortByKey(std::vector<R>& records,  // NOLINT
+                          KeyFunction key) {
+  // Sort the vector's records in place.
+  SortByKey(records.data(), records.size(), key);
+}
+
+template <typename R, typename... KeyFunctions>
+void RadixSort::SortByKeys(R* records, const int size, KeyFunctions... keys) {
+  // Sort the indices by the keys of their records, then move the records.
+  uint32_t* indices = record_indices_.Get<uint32_t>(size);
+  for (int i = 0; i < size; ++i) {
+    indices[i] = i;
+  }
+  SortIndicesByKeys(indices, size, [records, keys](const uint32_t index) {
+    return keys(records[index]);
+  }...);
+  ApplyPermutation(records, indices, size);
+}
+
+template <typename R, typename... KeyFunctions>
+void RadixSort::SortByKeys(std::vector<R>& records,  // NOLINT
+                           KeyFunctions... keys) {
+  // Sort the vector's records in place.
+  SortByKeys(records.data(), records.size(), keys...);
+}
+
+template <typename T, typename... Columns>
+std::vector<uint32_t> RadixSort::ArgSortColumns(
+    const std::vector<T>& column, const std::vector<Columns>&... columns) {
+  // Sort the indices by the rows of the columns.
+  const size_t sizes[] = {column.size(), columns.size()...};
+  for (const size_t size : sizes) {
+    if (size != column.size()) {
+      return std::vector<uint32_t>();
+    }
+  }
+  std::vector<uint32_t> indices(column.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    indices[i] = i;
+  }
+  SortIndicesByKeys(
+      indices.data(), indices.size(),
+      [&column](const uint32_t index) { return column[index]; },
+      [&columns](const uint32_t index) { return columns[index]; }...);
+  return indices;
+}
+
+template <typename I, typename KeyFunction, typename... KeyFunctions>
+void RadixSort::SortIndicesByKeys(I* indices, const int size, KeyFunction key,
+                                  KeyFunctions... keys) {
+  // Sort by the less significant keys first, then stable by this one.
+  SortIndicesByKeys(indices, size, keys...);
+  typedef typename std::decay<decltype(key(*indices))>::type K;
+  K* column = key_copy_.Get<K>(size);
+  for (int i = 0; i < size; ++i) {
+    column[i] = key(indices[i]);
+  }
+  SortPairsArray(column, indices, size);
+}
+
+template <typename R, typename I>
+void RadixSort::ApplyPermutation(R* records, I* indices, const int size) {
+  // Lift the first record of a cycle out and shift the rest into its hole.
+  for (int i = 0; i < size; ++i) {
+    if (indices[i] == static_cast<I>(i)) {
+      continue;
+    }
+    R first = std::move(records[i]);
+    int hole = i;
+    while (indices[hole] != static_cast<I>(i)) {
+      const int next = indices[hole];
+      records[hole] = std::move(records[next]);
+      indices[hole] = hole;
+      hole = next;
+    }
+    records[hole] = std::move(first);
+    indices[hole] = hole;
+  }
+}
+
+template <typename V>
+V* RadixSort::GetValueScratch(const int size, std::vector<V>* fallback) {
+  // Raw scratch memory only holds trivially copyable values.
+  if (std::is_trivially_copyable<V>::value) {
+    return placeholder_values_.Get<V>(size);
+  }
+  fallback->resize(size);
+  return fallback->data();
+}
+
+template <typename T>
+bool RadixSort::DetectSortType(enum SortType* type) {
+  // Expected types all but bool and long double.
+  const bool is_signed = std::numeric_limits<T>::is_signed;
+  const bool is_integer = std::numeric_limits<T>::is_integer;
+  if (is_signed && is_integer) {  // This is an integer type.
+    *type = SIGNED;
+  } else if (is_signed && !is_integer) {  // This is a floating point type.
+    *type = FLOAT;
+  } else if (!is_signed && is_integer) {  // This is an unsigned type.
+    *type = UNSIGNED;
+  } else {  // Not sure if this will ever be called, but it can't sort this
+            // type.
+    return false;
+  }
+  return true;
+}
+
+template <typename T>
+void RadixSort::Sort(std::vector<T>& array) {
+  Sort(array.data(), array.size());
+}
+
+template <typename T>
+void RadixSort::Sort(T* array, const int size) {
+  // Sort the array.  Expected types all but bool and long double.
+  enum SortType type;
+  if (!DetectSortType<T>(&type)) {
+    return;
+  }
+  RADIX_SORT_COUNT(stats_, sorts, 1);
+  RADIX_SORT_COUNT(stats_, elements, size);
+  switch (sizeof(T)) {
+    case 1:  // All 8 bit types.
+      SortWithStrategy(reinterpret_cast<uint8_t*>(array), size, type);
+      break;
+
+    case 2:  // All 16 bit types.
+      SortWithStrategy(reinterpret_cast<uint16_t*>(array), size, type);
+      break;
+
+    case 4:  // All 32 bit types.
+      SortWithStrategy(reinterpret_cast<uint32_t*>(array), size, type);
+      break;
+
+    case 8:  // All 64 bit types.
+      SortWithStrategy(reinterpret_cast<uint64_t*>(array), size, type);
+      break;
+
+    default:  // Can't handle this case.
+      return;
+  }
+#ifdef RADIX_SORT_STATS
+  if (stats_ != nullptr) {
+    stats_->scratch_bytes = std::max(stats_->scratch_bytes, scratch_bytes());
+  }
+#endif
+}
+
+template <typename T>
+void RadixSort::Sort(const T* input, T* output, const int size) {
+  // Sort input into output.  Expected types all but bool and long double.
+  enum SortType type;
+  const bool parallel = num_threads_ > 1 && sizeof(T) >= 4 &&
+                        size >= 2 * kMinElementsPerThread;
+  if (input == output || !DetectSortType<T>(&type) || strategy_ != LSD ||
+      parallel || sizeof(T) > 8) {
+    if (input != output) {
+      std::copy(input, input + size, output);
+    }
+    Sort(output, size);
+    return;
+  }
+  RADIX_SORT_COUNT(stats_, sorts, 1);
+  RADIX_SORT_COUNT(stats_, elements, size);
+  switch (sizeof(T)) {
+    case 1:  // All 8 bit types.
+      CountingSort(reinterpret_cast<const uint8_t*>(input),
+                   reinterpret_cast<uint8_t*>(output), size, type);
+      break;
+
+    case 2:  // All 16 bit types.
+      CountingSort(reinterpret_cast<const uint16_t*>(input),
+                   reinterpret_cast<uint16_t*>(output), size, type);
+      break;
+
+    case 4:  // All 32 bit types.
+      SortDigitsFor(reinterpret_cast<const uint32_t*>(input),
+                    reinterpret_cast<uint32_t*>(output), size, type);
+      break;
+
+    default:  // All 64 bit types.
+      SortDigitsFor(reinterpret_cast<const uint64_t*>(input),
+                    reinterpret_cast<uint64_t*>(output), size, type);
+  }
+#ifdef RADIX_SORT_STATS
+  if (stats_ != nullptr) {
+    stats_->scratch_bytes = std::max(stats_->scratch_bytes, scratch_bytes());
+  }
+#endif
+}
+
+template <typename T>
+void RadixSort::SortSegments(T* data, const int* offsets,
+                             const int segments) {
+  // Sort the segments.  Expected types all but bool and long double.
+  enum SortType type;
+  if (segments <= 0 || !DetectSortType<T>(&type)) {
+    return;
+  }
+  RADIX_SORT_COUNT(stats_, sorts, segments);
+  RADIX_SORT_COUNT(stats_, elements, offsets[segments] - offsets[0]);
+  switch (sizeof(T)) {
+    case 1:  // All 8 bit types.
+      SortSegmentsType(reinterpret_cast<uint8_t*>(data), offsets, segments,
+                       type);
+      break;
+
+    case 2:  // All 16 bit types.
+      SortSegmentsType(reinterpret_cast<uint16_t*>(data), offsets, segments,
+                       type);
+      break;
+
+    case 4:  // All 32 bit types.
+      SortSegmentsType(reinterpret_cast<uint32_t*>(data), offsets, segments,
+                       type);
+      break;
+
+    case 8:  // All 64 bit types.
+      SortSegmentsType(reinterpret_cast<uint64_t*>(data), offsets, segments,
+                       type);
+      break;
+
+    default:  // Can't handle this case.
+      return;
+  }
+#ifdef RADIX_SORT_STATS
+  if (stats_ != nullptr) {
+    stats_->scratch_bytes = std::max(stats_->scratch_bytes, scratch_bytes());
+  }
+#endif
+}
+
+template <typename T>
+void RadixSort::SortSegments(std::vector<T>& data,  // NOLINT
+                             const std::vector<int>& offsets) {
+  if (offsets.size() < 2 ||
+      offsets.back() > static_cast<int>(data.size())) {
+    return;
+  }
+  SortSegments(data.data(), offsets.data(), offsets.size() - 1);
+}
+
+template <typename T>
+void RadixSort::SortSegmentsType(T* data, const int* offsets,
+                                 const int segments,
+                                 const enum SortType type) {
+  // Thread t starts at the first segment ending past t / num_threads of the
+  // elements.  Every thread but the first sorts with its own kept sorter.
+  const int total = offsets[segments] - offsets[0];
+  const int num_threads = std::min(
+      {num_threads_, segments, std::max(1, total / kMinElementsPerThread)});
+  if (num_threads <= 1) {
+    SortSegmentRange(data, offsets, 0, segments, type);
+    return;
+  }
+  std::vector<int> firsts(num_threads + 1, segments);
+  firsts[0] = 0;
+  for (int thread = 1; thread < num_threads; ++thread) {
+    const int64_t start =
+        offsets[0] + static_cast<int64_t>(total) * thread / num_threads;
+    firsts[thread] =
+        std::upper_bound(offsets, offsets + segments, start) - offsets - 1;
+  }
+  while (static_cast<int>(segment_sorters_.size()) < num_threads - 1) {
+    segment_sorters_.emplace_back(new RadixSort);
+  }
+  for (int thread = 1; thread < num_threads; ++thread) {
+    segment_sorters_[thread - 1]->CopySettings(*this);
+  }
+  RunParallel(num_threads, [&](const int thread) {
+    RadixSort* sorter =
+        thread == 0 ? this : segment_sorters_[thread - 1].get();
+    sorter->SortSegmentRange(data, offsets, firsts[thread],
+                             firsts[thread + 1], type);
+  });
+}
+
+template <typename T>
+void RadixSort::SortSegmentRange(T* data, const int* offsets, const int first,
+                                 const int last, const enum SortType type) {
+  // Grow the scratch memory once, for the largest segment.
+  int largest = 0;
+  for (int segment = first; segment < last; ++segment) {
+    largest = std::max(largest, offsets[segment + 1] - offsets[segment]);
+  }
+  placeholder_.Get<T>(largest);
+  for (int segment = first; segment < last; ++segment) {
+    SortSegment(data + offsets[segment],
+                offsets[segment + 1] - offsets[segment], type);
+  }
+}
+
+template <typename T>
+void RadixSort::SortSegment(T* array, const int size,
+                            const enum SortType type) {
+  // A comparison sort for tiny segments, a counting sort for 8-bit and large
+  // 16-bit ones and LSD on digits that suit the size otherwise.
+  if (size <= kSegmentComparisonSortSize) {
+    FlipArray(array, size, type, order_ == DESCENDING);
+    SmallSort(array, size);
+    FlopArray(array, size, type, order_ == DESCENDING);
+    return;
+  }
+  if (sizeof(T) == 1 ||
+      (sizeof(T) == 2 && size >= kSegmentCountingSortSize)) {
+    CountingSort(array, array, size, type);
+    return;
+  }
+  if (sizeof(T) >= 4 && SortPresorted(array, size, type)) {
+    return;
+  }
+  const int bits = digit_bits_ == 8 || digit_bits_ == 16
+                       ? digit_bits_
+                       : TunedDigitBits(size, sizeof(T));
+  switch (sizeof(T) == 2 ? 8 : bits) {
+    case 8:
+      SortDigits<8>(array, size, type);
+      break;
+    case 16:
+      SortDigits<16>(array, size, type);
+      break;
+    default:
+      SortDigits<11>(array, size, type);
+  }
+}
+
+template <typename K, typename V>
+void RadixSort::SortPairs(std::vector<K>& keys,  // NOLINT
+                          std::vector<V>& values) {  // NOLINT
+  // Sort the keys, values follow their keys.
+  if (keys.size() != values.size()) {
+    return;
+  }
+  SortPairsArray(keys.data(), values.data(), keys.size());
+}
+
+template <typename K, typename V>
+void RadixSort::SortPairsArray(K* keys, V* values, const int size) {
+  // Detect the key type and sort based on its bit structure.
+  enum SortType type;
+  if (!DetectSortType<K>(&type)) {
+    return;
+  }
+  switch (sizeof(K)) {
+    case 1:  // All 8 bit types.
+      SortPairsType(reinterpret_cast<uint8_t*>(keys), values, size, type);
+      break;
+
+    case 2:  // All 16 bit types.
+      SortPairsType(reinterpret_cast<uint16_t*>(keys), values, size, type);
+      break;
 
     case 4:  // All 32 bit types.
-      SortType(reinterpret_cast<uint32_t*>(&array[0]), array.size(), type);
+      SortPairsType(reinterpret_cast<uint32_t*>(keys), values, size, type);
       break;
 
     case 8:  // All 64 bit types.
-      SortType(reinterpret_cast<uint64_t*>(&array[0]), array.size(), type);
+      SortPairsType(reinterpret_cast<uint64_t*>(keys), values, size, type);
       break;
 
     default:  // Can't handle this case.
@@ -180,4 +2561,14 @@ void RadixSort::Sort(std::vector<T>& array) {
   }
 }
 
+template <typename K, typename V>
+void RadixSort::SortPairs(std::vector<std::pair<K, V>>& pairs) {  // NOLINT
+  // Sort a copy of the keys and carry the whole pairs along as the values.
+  K* keys = key_copy_.Get<K>(pairs.size());
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    keys[i] = pairs[i].first;
+  }
+  SortPairsArray(keys, pairs.data(), pairs.size());
+}
+
 #endif  // RADIX_SORT_H_
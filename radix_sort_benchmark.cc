@@ -0,0 +1,653 @@
+// Copyright 2015 Kevin Melkowski
+
+#include "sort/radix_sort/radix_sort.h"
+#include "sort/radix_sort/streaming_sort.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+template <typename T>
+std::vector<T> RandomValues(const int size) {
+  // Uniformly random bit patterns, fixed seed so runs are comparable.
+  std::mt19937_64 generator(13);
+  std::vector<T> values(size);
+  for (auto& value : values) {
+    value = static_cast<T>(generator());
+  }
+  return values;
+}
+
+template <typename T>
+void BM_ParallelSort(benchmark::State& state) {
+  // Sorts state.range(0) elements on state.range(1) threads.
+  const std::vector<T> input = RandomValues<T>(state.range(0));
+  RadixSort sort(state.range(1));
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    sort.Sort(values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+}
+
+void ThreadScaling(benchmark::internal::Benchmark* benchmark) {
+  // 1, 2, 4, ... threads up to the number of hardware cores.
+  const int max_threads =
+      std::max<int>(1, std::thread::hardware_concurrency());
+  for (int size : {1 << 20, 1 << 24}) {
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+      benchmark->Args({size, threads});
+    }
+    benchmark->Args({size, max_threads});
+  }
+  benchmark->ArgNames({"size", "threads"});
+}
+
+BENCHMARK_TEMPLATE(BM_ParallelSort, uint32_t)
+    ->Apply(ThreadScaling)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ParallelSort, uint64_t)
+    ->Apply(ThreadScaling)
+    ->UseRealTime();
+
+template <typename T>
+void BM_NumaSort(benchmark::State& state) {
+  // Sorts state.range(0) elements on every hardware thread, spread across the
+  // system's NUMA nodes if state.range(1) is 1.  On multi-socket Linux
+  // machines compare the two with the input interleaved over the nodes,
+  //   numactl --interleave=all radix_sort_benchmark --benchmark_filter=Numa
+  // and against one socket with --cpunodebind=0 --membind=0.  Scratch
+  // memory, node buffers included, is freed before every sort if
+  // state.range(2) is 1 and reused otherwise.
+  const std::vector<T> input = RandomValues<T>(state.range(0));
+  RadixSort sort(0);
+  if (state.range(1) == 1) {
+    sort.set_numa_topology(&NumaTopology::System());
+  }
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    if (state.range(2) == 1) {
+      sort.ReleaseScratch();
+    }
+    state.ResumeTiming();
+    sort.Sort(values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+  state.counters["nodes"] = NumaTopology::System().nodes();
+}
+
+BENCHMARK_TEMPLATE(BM_NumaSort, uint64_t)
+    ->ArgsProduct({{1 << 24, 1 << 27}, {0, 1}, {0, 1}})
+    ->ArgNames({"size", "numa", "release"})
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_NumaSort, double)
+    ->ArgsProduct({{1 << 24, 1 << 27}, {0, 1}, {0, 1}})
+    ->ArgNames({"size", "numa", "release"})
+    ->UseRealTime();
+
+template <typename T>
+void BM_NarrowRangeSort(benchmark::State& state) {
+  // Sorts timestamp-like values that only vary in the low state.range(1)
+  // bits, the constant upper digits skip their passes.
+  std::mt19937_64 generator(13);
+  std::vector<T> input(state.range(0));
+  const uint64_t mask =
+      state.range(1) >= 64 ? ~0ULL : (1ULL << state.range(1)) - 1;
+  for (auto& value : input) {
+    value = static_cast<T>(0x1400000000000000ULL | (generator() & mask));
+  }
+  RadixSort sort;
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    sort.Sort(values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+}
+
+BENCHMARK_TEMPLATE(BM_NarrowRangeSort, uint64_t)
+    ->ArgsProduct({{1 << 20, 1 << 24}, {11, 22, 33, 44, 64}})
+    ->ArgNames({"size", "bits"});
+
+template <typename T>
+void BM_StrategySort(benchmark::State& state) {
+  // Sorts state.range(0) random elements with SortStrategy state.range(1).
+  const std::vector<T> input = RandomValues<T>(state.range(0));
+  RadixSort sort;
+  sort.set_strategy(static_cast<SortStrategy>(state.range(1)));
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    sort.Sort(values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+  state.counters["scratch_bytes"] = sort.scratch_bytes();
+}
+
+void SizesAndStrategies(benchmark::internal::Benchmark* benchmark) {
+  // Sizes from 16 up to 2^24, or up to RADIX_SORT_BENCHMARK_MAX_SIZE (e.g.
+  // 1000000000) if set, for every strategy.
+  int64_t max_size = 1 << 24;
+  if (const char* max = std::getenv("RADIX_SORT_BENCHMARK_MAX_SIZE")) {
+    max_size = std::atoll(max);
+  }
+  for (int64_t size = 16; size <= max_size; size *= 16) {
+    for (const int strategy : {LSD, IN_PLACE_MSD, HYBRID}) {
+      benchmark->Args({size, strategy});
+    }
+  }
+  benchmark->ArgNames({"size", "strategy"});
+}
+
+BENCHMARK_TEMPLATE(BM_StrategySort, uint32_t)->Apply(SizesAndStrategies);
+BENCHMARK_TEMPLATE(BM_StrategySort, uint64_t)->Apply(SizesAndStrategies);
+
+template <typename T>
+void BM_Histogram(benchmark::State& state) {
+  // Builds the histograms of state.range(0) keys of SortType state.range(3)
+  // with SimdLevel state.range(1), random keys if state.range(2) is 0 and
+  // equal keys otherwise.
+  std::vector<T> input = RandomValues<T>(state.range(0));
+  if (state.range(2) != 0) {
+    std::fill(input.begin(), input.end(), input[0]);
+  }
+  Histogram histogram;
+  histogram.set_simd_level(static_cast<SimdLevel>(state.range(1)));
+  if (histogram.simd_level() != state.range(1)) {
+    state.SkipWithError("Instruction set not supported");
+    return;
+  }
+  std::vector<kHistogramDataType> counts(6 * 2048);
+  for (auto _ : state) {
+    histogram.GetHistogram(input.data(), input.size(),
+                           static_cast<SortType>(state.range(3)),
+                           counts.data());
+    benchmark::DoNotOptimize(counts.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+}
+
+void HistogramArgs(benchmark::internal::Benchmark* benchmark) {
+  // Every instruction set on random and equal, unsigned and float keys.
+  benchmark->ArgsProduct(
+      {{1 << 20}, {SCALAR, AVX2}, {0, 1}, {UNSIGNED, FLOAT}});
+  benchmark->ArgNames({"size", "simd", "equal", "type"});
+}
+
+BENCHMARK_TEMPLATE(BM_Histogram, uint32_t)->Apply(HistogramArgs);
+BENCHMARK_TEMPLATE(BM_Histogram, uint64_t)->Apply(HistogramArgs);
+
+template <typename T>
+void BM_ScatterSort(benchmark::State& state) {
+  // Sorts state.range(0) random elements with ScatterMode state.range(1).
+  const std::vector<T> input = RandomValues<T>(state.range(0));
+  RadixSort sort;
+  sort.set_scatter_mode(static_cast<ScatterMode>(state.range(1)));
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    sort.Sort(values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+}
+
+BENCHMARK_TEMPLATE(BM_ScatterSort, uint32_t)
+    ->ArgsProduct({{1 << 16, 1 << 20, 1 << 24}, {DIRECT, BUFFERED, STREAMING}})
+    ->ArgNames({"size", "scatter"});
+BENCHMARK_TEMPLATE(BM_ScatterSort, uint64_t)
+    ->ArgsProduct({{1 << 16, 1 << 20, 1 << 24}, {DIRECT, BUFFERED, STREAMING}})
+    ->ArgNames({"size", "scatter"});
+
+template <typename T>
+void BM_DigitBitsSort(benchmark::State& state) {
+  // Sorts state.range(0) random elements on state.range(1) bit digits, 0 for
+  // the tuned width.
+  const std::vector<T> input = RandomValues<T>(state.range(0));
+  RadixSort sort;
+  sort.set_digit_bits(state.range(1));
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    sort.Sort(values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+}
+
+BENCHMARK_TEMPLATE(BM_DigitBitsSort, uint32_t)
+    ->ArgsProduct({{1 << 8, 1 << 12, 1 << 16, 1 << 20, 1 << 24},
+                   {8, 11, 16, kAutoDigitBits}})
+    ->ArgNames({"size", "bits"});
+BENCHMARK_TEMPLATE(BM_DigitBitsSort, uint64_t)
+    ->ArgsProduct({{1 << 8, 1 << 12, 1 << 16, 1 << 20, 1 << 24},
+                   {8, 11, 16, kAutoDigitBits}})
+    ->ArgNames({"size", "bits"});
+
+// A record of kBytes bytes sorted by its leading key.
+template <int kBytes>
+struct Record {
+  uint64_t key;
+  char payload[kBytes - sizeof(uint64_t)];
+};
+
+template <int kBytes>
+std::vector<Record<kBytes>> RandomRecords(const int size) {
+  // Random keys, payloads left as they are.
+  const std::vector<uint64_t> keys = RandomValues<uint64_t>(size);
+  std::vector<Record<kBytes>> records(size);
+  for (int i = 0; i < size; ++i) {
+    records[i].key = keys[i];
+  }
+  return records;
+}
+
+template <int kBytes>
+void BM_SortByKey(benchmark::State& state) {
+  // Sorts state.range(0) records of kBytes bytes by key.
+  const std::vector<Record<kBytes>> input =
+      RandomRecords<kBytes>(state.range(0));
+  RadixSort sort;
+  std::vector<Record<kBytes>> records;
+  for (auto _ : state) {
+    state.PauseTiming();
+    records = input;
+    state.ResumeTiming();
+    sort.SortByKey(records,
+                   [](const Record<kBytes>& record) { return record.key; });
+    benchmark::DoNotOptimize(records.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * kBytes);
+}
+
+template <int kBytes>
+void BM_StableSortByKey(benchmark::State& state) {
+  // std::stable_sort baseline for BM_SortByKey.
+  const std::vector<Record<kBytes>> input =
+      RandomRecords<kBytes>(state.range(0));
+  std::vector<Record<kBytes>> records;
+  for (auto _ : state) {
+    state.PauseTiming();
+    records = input;
+    state.ResumeTiming();
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record<kBytes>& a, const Record<kBytes>& b) {
+                       return a.key < b.key;
+                     });
+    benchmark::DoNotOptimize(records.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * kBytes);
+}
+
+BENCHMARK_TEMPLATE(BM_SortByKey, 16)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_SortByKey, 32)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_SortByKey, 128)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_StableSortByKey, 16)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_StableSortByKey, 32)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_StableSortByKey, 128)->Arg(1 << 20);
+
+template <typename T>
+void BM_DescendingSort(benchmark::State& state) {
+  // Sorts state.range(0) random elements descending, with set_order if
+  // state.range(1) is 0 and by reversing an ascending sort otherwise.
+  const std::vector<T> input = RandomValues<T>(state.range(0));
+  RadixSort sort;
+  if (state.range(1) == 0) {
+    sort.set_order(DESCENDING);
+  }
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    sort.Sort(values);
+    if (state.range(1) != 0) {
+      std::reverse(values.begin(), values.end());
+    }
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+}
+
+BENCHMARK_TEMPLATE(BM_DescendingSort, uint32_t)
+    ->ArgsProduct({{1 << 16, 1 << 20}, {0, 1}})
+    ->ArgNames({"size", "reverse"});
+BENCHMARK_TEMPLATE(BM_DescendingSort, uint64_t)
+    ->ArgsProduct({{1 << 16, 1 << 20}, {0, 1}})
+    ->ArgNames({"size", "reverse"});
+
+template <typename T>
+void BM_PartialSort(benchmark::State& state) {
+  // Sorts the smallest state.range(1) of state.range(0) random elements with
+  // PartialSort if state.range(2) is 0 and std::partial_sort otherwise.
+  const std::vector<T> input = RandomValues<T>(state.range(0));
+  RadixSort sort;
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    if (state.range(2) == 0) {
+      sort.PartialSort(values, state.range(1));
+    } else {
+      std::partial_sort(values.begin(), values.begin() + state.range(1),
+                        values.end());
+    }
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+
+BENCHMARK_TEMPLATE(BM_PartialSort, float)
+    ->ArgsProduct({{1 << 24}, {1000, 1 << 20}, {0, 1}})
+    ->ArgNames({"size", "k", "std_sort"});
+BENCHMARK_TEMPLATE(BM_PartialSort, uint64_t)
+    ->ArgsProduct({{1 << 24}, {1000, 1 << 20}, {0, 1}})
+    ->ArgNames({"size", "k", "std_sort"});
+
+template <typename T>
+void BM_StreamingSort(benchmark::State& state) {
+  // Adds 64 batches of state.range(0) random elements and takes a sorted
+  // view after every 8th, with StreamingSort if state.range(1) is 0 and by
+  // sorting everything so far again otherwise.
+  const int batch = state.range(0);
+  const std::vector<T> input = RandomValues<T>(64 * batch);
+  for (auto _ : state) {
+    if (state.range(1) == 0) {
+      StreamingSort<T> sorter;
+      for (int i = 0; i < 64; ++i) {
+        sorter.Add(input.data() + i * batch, batch);
+        if (i % 8 == 7) {
+          benchmark::DoNotOptimize(sorter.Sorted().data());
+        }
+      }
+    } else {
+      RadixSort sort;
+      std::vector<T> values;
+      for (int i = 0; i < 64; ++i) {
+        values.insert(values.end(), input.begin() + i * batch,
+                      input.begin() + (i + 1) * batch);
+        if (i % 8 == 7) {
+          sort.Sort(values);
+          benchmark::DoNotOptimize(values.data());
+        }
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+
+BENCHMARK_TEMPLATE(BM_StreamingSort, uint64_t)
+    ->ArgsProduct({{1 << 12, 1 << 16}, {0, 1}})
+    ->ArgNames({"batch", "resort"});
+
+template <typename T>
+void BM_PresortedSort(benchmark::State& state) {
+  // Sorts state.range(0) elements that are sorted (state.range(1) 0),
+  // reversed (1) or state.range(1) sorted runs, with the presorted scan on
+  // if state.range(2) is 0 and off otherwise.
+  std::vector<T> input = RandomValues<T>(state.range(0));
+  const int runs = std::max<int>(1, state.range(1));
+  const int run_size = input.size() / runs;
+  for (int run = 0; run < runs; ++run) {
+    std::sort(input.begin() + run * run_size,
+              run == runs - 1 ? input.end()
+                              : input.begin() + (run + 1) * run_size);
+  }
+  if (state.range(1) == 0) {
+    std::reverse(input.begin(), input.end());
+  }
+  RadixSort sort;
+  sort.set_presorted_runs(state.range(2) == 0 ? kPresortedRuns : 0);
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    sort.Sort(values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+}
+
+BENCHMARK_TEMPLATE(BM_PresortedSort, uint32_t)
+    ->ArgsProduct({{1 << 22}, {0, 1, 4, 8, 1 << 12}, {0, 1}})
+    ->ArgNames({"size", "runs", "no_scan"});
+BENCHMARK_TEMPLATE(BM_PresortedSort, double)
+    ->ArgsProduct({{1 << 22}, {0, 1, 4, 8, 1 << 12}, {0, 1}})
+    ->ArgNames({"size", "runs", "no_scan"});
+
+template <typename T>
+void BM_OutOfPlaceSort(benchmark::State& state) {
+  // Sorts state.range(0) elements into a separate output, through the fused
+  // out-of-place sort if state.range(1) is 0 and as a copy and an in-place
+  // sort otherwise.
+  const std::vector<T> input = RandomValues<T>(state.range(0));
+  std::vector<T> output(input.size());
+  RadixSort sort;
+  for (auto _ : state) {
+    if (state.range(1) == 0) {
+      sort.Sort(input.data(), output.data(), input.size());
+    } else {
+      std::copy(input.begin(), input.end(), output.begin());
+      sort.Sort(output);
+    }
+    benchmark::DoNotOptimize(output.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+}
+
+BENCHMARK_TEMPLATE(BM_OutOfPlaceSort, uint32_t)
+    ->ArgsProduct({{1 << 16, 1 << 24}, {0, 1}})
+    ->ArgNames({"size", "copy"});
+BENCHMARK_TEMPLATE(BM_OutOfPlaceSort, float)
+    ->ArgsProduct({{1 << 16, 1 << 24}, {0, 1}})
+    ->ArgNames({"size", "copy"});
+BENCHMARK_TEMPLATE(BM_OutOfPlaceSort, uint16_t)
+    ->ArgsProduct({{1 << 16, 1 << 24}, {0, 1}})
+    ->ArgNames({"size", "copy"});
+
+template <typename T>
+void BM_SegmentedSort(benchmark::State& state) {
+  // Sorts state.range(0) segments of 50 to state.range(1) elements, with
+  // SortSegments if state.range(2) is 0 and one Sort per segment otherwise.
+  std::mt19937 generator(13);
+  std::vector<int> offsets({0});
+  for (int segment = 0; segment < state.range(0); ++segment) {
+    offsets.push_back(offsets.back() + 50 +
+                      generator() % (state.range(1) - 49));
+  }
+  const std::vector<T> input = RandomValues<T>(offsets.back());
+  RadixSort sort;
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    if (state.range(2) == 0) {
+      sort.SortSegments(values, offsets);
+    } else {
+      for (int segment = 0; segment < state.range(0); ++segment) {
+        sort.Sort(values.data() + offsets[segment],
+                  offsets[segment + 1] - offsets[segment]);
+      }
+    }
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+}
+
+BENCHMARK_TEMPLATE(BM_SegmentedSort, uint32_t)
+    ->ArgsProduct({{10000}, {500, 5000}, {0, 1}})
+    ->ArgNames({"segments", "max_size", "per_segment"});
+BENCHMARK_TEMPLATE(BM_SegmentedSort, double)
+    ->ArgsProduct({{10000}, {500, 5000}, {0, 1}})
+    ->ArgNames({"segments", "max_size", "per_segment"});
+BENCHMARK_TEMPLATE(BM_SegmentedSort, int16_t)
+    ->ArgsProduct({{10000}, {500, 5000}, {0, 1}})
+    ->ArgNames({"segments", "max_size", "per_segment"});
+
+void BM_ArgSortColumns(benchmark::State& state) {
+  // Orders state.range(0) (tenant, timestamp, score) rows.
+  const int size = state.range(0);
+  const std::vector<uint32_t> tenants = RandomValues<uint32_t>(size);
+  const std::vector<int64_t> timestamps = RandomValues<int64_t>(size);
+  std::vector<float> scores(size);
+  for (int i = 0; i < size; ++i) {
+    scores[i] = static_cast<float>(static_cast<int32_t>(tenants[i]));
+  }
+  std::vector<uint32_t> narrow_tenants(tenants);
+  for (auto& tenant : narrow_tenants) {  // Few tenants, so all columns count.
+    tenant %= 64;
+  }
+  RadixSort sort;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        sort.ArgSortColumns(narrow_tenants, timestamps, scores).data());
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+}
+
+BENCHMARK(BM_ArgSortColumns)->Arg(1 << 16)->Arg(1 << 20);
+
+void BM_Sort128(benchmark::State& state) {
+  // Sorts state.range(0) random 128-bit hashes.
+  const std::vector<uint64_t> halves =
+      RandomValues<uint64_t>(2 * state.range(0));
+  std::vector<unsigned __int128> input(state.range(0));
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = static_cast<unsigned __int128>(halves[2 * i]) << 64 |
+               halves[2 * i + 1];
+  }
+  RadixSort sort;
+  std::vector<unsigned __int128> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    sort.Sort(values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+
+BENCHMARK(BM_Sort128)->Arg(1 << 16)->Arg(1 << 20);
+
+template <size_t N>
+void BM_ByteKeySort(benchmark::State& state) {
+  // Sorts state.range(0) random N byte keys.
+  const std::vector<uint8_t> bytes = RandomValues<uint8_t>(N * state.range(0));
+  std::vector<std::array<uint8_t, N>> input(state.range(0));
+  for (size_t i = 0; i < input.size(); ++i) {
+    std::copy(&bytes[N * i], &bytes[N * i] + N, input[i].begin());
+  }
+  RadixSort sort;
+  std::vector<std::array<uint8_t, N>> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    sort.Sort(values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+
+BENCHMARK_TEMPLATE(BM_ByteKeySort, 16)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_ByteKeySort, 20)->Arg(1 << 16)->Arg(1 << 20);
+
+std::vector<std::string> RandomStrings(const int size, const int kind) {
+  // kind 0: URLs, a few hosts followed by paths of 1 to 4 lowercase segments.
+  // kind 1: keys of 8 to 24 random alphanumeric characters.
+  std::mt19937_64 generator(13);
+  const char alphabet[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  std::vector<std::string> strings(size);
+  for (auto& string : strings) {
+    if (kind == 0) {
+      string = "https://www.host" + std::to_string(generator() % 64) + ".com";
+      for (int segment = generator() % 4; segment >= 0; --segment) {
+        string += '/';
+        for (int length = 3 + generator() % 10; length > 0; --length) {
+          string += alphabet[generator() % 26];
+        }
+      }
+    } else {
+      for (int length = 8 + generator() % 17; length > 0; --length) {
+        string += alphabet[generator() % 62];
+      }
+    }
+  }
+  return strings;
+}
+
+void BM_StringSort(benchmark::State& state) {
+  // Sorts state.range(0) strings of RandomStrings kind state.range(1), with
+  // the radix sort if state.range(2) is 0 and std::sort otherwise.
+  const std::vector<std::string> storage =
+      RandomStrings(state.range(0), state.range(1));
+  const std::vector<std::string_view> input(storage.begin(), storage.end());
+  RadixSort sort;
+  std::vector<std::string_view> strings;
+  for (auto _ : state) {
+    state.PauseTiming();
+    strings = input;
+    state.ResumeTiming();
+    if (state.range(2) == 0) {
+      sort.Sort(strings);
+    } else {
+      std::sort(strings.begin(), strings.end());
+    }
+    benchmark::DoNotOptimize(strings.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+
+BENCHMARK(BM_StringSort)
+    ->ArgsProduct({{1 << 12, 1 << 16, 1 << 20}, {0, 1}, {0, 1}})
+    ->ArgNames({"size", "kind", "std_sort"});
+
+}  // namespace
+
+BENCHMARK_MAIN();
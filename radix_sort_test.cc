@@ -4,7 +4,15 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <array>
+#include <functional>
 #include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "glog/logging.h"
@@ -88,6 +96,1180 @@ TEST_F(RadixSortTest, TestiDoubleSorting) {
   EXPECT_EQ(expected, values);
 }
 
+TEST_F(RadixSortTest, TestPointerSorting) {
+  // Tests sorting part of a caller owned array in place.
+  double values[] = {13, -123, 0.5, -11.13, 127.127, 113, -1};
+  sort_->Sort(values + 1, 5);
+  std::vector<double> expected({13, -123, -11.13, 0.5, 113, 127.127, -1});
+  EXPECT_EQ(expected, std::vector<double>(values, values + 7));
+}
+
+TEST_F(RadixSortTest, TestOutOfPlaceSorting) {
+  // Tests sorting into a separate output for odd and even pass counts, small
+  // keys, descending order and the copying fallback.
+  std::mt19937_64 generator(13);
+  std::vector<int64_t> longs(5000);
+  for (auto& value : longs) {
+    value = generator();
+  }
+  const std::vector<int64_t> input(longs);
+  std::vector<int64_t> expected(longs);
+  std::sort(expected.begin(), expected.end());
+  std::vector<int64_t> output(longs.size());
+  sort_->Sort(input.data(), output.data(), input.size());
+  EXPECT_EQ(expected, output);
+  EXPECT_EQ(longs, input);
+
+  std::vector<float> floats({13, -123, 0.5, -11.13, 127.127, 113, -0.0});
+  std::vector<float> sorted_floats(floats);
+  std::sort(sorted_floats.begin(), sorted_floats.end());
+  std::vector<float> float_output(floats.size());
+  sort_->Sort(floats.data(), float_output.data(), floats.size());
+  EXPECT_EQ(sorted_floats, float_output);
+  sort_->set_digit_bits(16);  // Two passes instead of three.
+  sort_->Sort(floats.data(), float_output.data(), floats.size());
+  EXPECT_EQ(sorted_floats, float_output);
+
+  std::vector<int8_t> chars({13, -123, 0, -11, 127, 113, -1, 0, -128});
+  std::vector<int8_t> sorted_chars(chars);
+  std::sort(sorted_chars.begin(), sorted_chars.end(), std::greater<int8_t>());
+  std::vector<int8_t> char_output(chars.size());
+  sort_->set_order(DESCENDING);
+  sort_->Sort(chars.data(), char_output.data(), chars.size());
+  EXPECT_EQ(sorted_chars, char_output);
+
+  std::vector<int16_t> shorts(1 << 18);  // Dense enough to skip the scatter.
+  for (auto& value : shorts) {
+    value = generator();
+  }
+  std::vector<int16_t> sorted_shorts(shorts);
+  std::sort(sorted_shorts.begin(), sorted_shorts.end(),
+            std::greater<int16_t>());
+  std::vector<int16_t> short_output(shorts.size());
+  sort_->Sort(shorts.data(), short_output.data(), shorts.size());
+  EXPECT_EQ(sorted_shorts, short_output);
+  sort_->set_order(ASCENDING);
+  sort_->Sort(shorts);
+  std::reverse(sorted_shorts.begin(), sorted_shorts.end());
+  EXPECT_EQ(sorted_shorts, shorts);
+
+  sort_->set_strategy(HYBRID);
+  sort_->Sort(input.data(), output.data(), input.size());
+  EXPECT_EQ(expected, output);
+}
+
+TEST_F(RadixSortTest, TestSegmentedSorting) {
+  // Tests that every segment is sorted on its own, for segment sizes from
+  // empty to past the comparison sort cutoff, on one and on four threads.
+  std::mt19937_64 generator(13);
+  std::vector<int> offsets({0});
+  while (offsets.back() < 3 * kMinElementsPerThread) {
+    const int size = generator() % 4 == 0 ? generator() % 20
+                                          : generator() % 5000;
+    offsets.push_back(offsets.back() + size);
+  }
+  std::vector<int64_t> longs(offsets.back());
+  std::vector<int16_t> shorts(offsets.back());
+  for (size_t i = 0; i < longs.size(); ++i) {
+    longs[i] = generator();
+    shorts[i] = generator();
+  }
+  std::vector<int64_t> expected_longs(longs);
+  std::vector<int16_t> expected_shorts(shorts);
+  for (size_t segment = 0; segment + 1 < offsets.size(); ++segment) {
+    std::sort(expected_longs.begin() + offsets[segment],
+              expected_longs.begin() + offsets[segment + 1]);
+    std::sort(expected_shorts.begin() + offsets[segment],
+              expected_shorts.begin() + offsets[segment + 1],
+              std::greater<int16_t>());
+  }
+  std::vector<int64_t> parallel_longs(longs);
+  sort_->SortSegments(longs, offsets);
+  EXPECT_EQ(expected_longs, longs);
+  sort_->set_num_threads(4);
+  sort_->SortSegments(parallel_longs, offsets);
+  EXPECT_EQ(expected_longs, parallel_longs);
+  sort_->set_order(DESCENDING);
+  sort_->SortSegments(shorts, offsets);
+  EXPECT_EQ(expected_shorts, shorts);
+}
+
+TEST_F(RadixSortTest, TestSegmentedSortingOffsets) {
+  // Tests segments that don't start at the front, floats, a segment large
+  // enough for 16-bit digits and offsets past the end.
+  std::vector<float> values({3, 2, 1, -1.5, 0.5, -0.5, 7, 5, 6});
+  const int offsets[] = {1, 3, 3, 6};
+  sort_->SortSegments(values.data(), offsets, 3);
+  EXPECT_EQ(std::vector<float>({3, 1, 2, -1.5, -0.5, 0.5, 7, 5, 6}), values);
+  sort_->SortSegments(values, std::vector<int>({0, 10}));
+  EXPECT_EQ(std::vector<float>({3, 1, 2, -1.5, -0.5, 0.5, 7, 5, 6}), values);
+
+  std::mt19937 generator(13);
+  std::vector<uint32_t> wide(1 << 14);
+  for (auto& value : wide) {
+    value = generator();
+  }
+  std::vector<uint32_t> expected(wide);
+  std::sort(expected.begin() + 1, expected.end());
+  sort_->set_digit_bits(16);
+  sort_->SortSegments(wide, std::vector<int>({0, 1, 1 << 14}));
+  EXPECT_EQ(expected, wide);
+}
+
+TEST_F(RadixSortTest, TestParallelUnsignedIntSorting) {
+  // Tests that the parallel sort matches std::sort for unsigned ints.
+  std::mt19937 generator(13);
+  std::vector<uint32_t> values(4 * kMinElementsPerThread + 17);
+  for (auto& value : values) {
+    value = generator();
+  }
+  std::vector<uint32_t> expected(values);
+  std::sort(expected.begin(), expected.end());
+  sort_->set_num_threads(4);
+  sort_->Sort(values);
+  EXPECT_EQ(expected, values);
+}
+
+TEST_F(RadixSortTest, TestNumaSorting) {
+  // Tests the NUMA sort against std::sort on made up two and three node
+  // topologies, for doubles, signed ints, descending order, keys that all
+  // land on one node, a repeated sort reusing the node scratch memory and
+  // threads that can't be pinned.
+  const NumaTopology two_nodes({{0}, {0}});
+  const NumaTopology three_nodes({{0}, {0}, {0}});
+  std::mt19937_64 generator(13);
+  std::uniform_real_distribution<double> distribution(-1e6, 1e6);
+  std::vector<double> doubles(4 * kMinElementsPerThread + 17);
+  for (auto& value : doubles) {
+    value = distribution(generator);
+  }
+  std::vector<double> expected_doubles(doubles);
+  std::sort(expected_doubles.begin(), expected_doubles.end());
+  sort_->set_num_threads(4);
+  sort_->set_numa_topology(&two_nodes);
+  sort_->Sort(doubles);
+  EXPECT_EQ(expected_doubles, doubles);
+
+  std::vector<int32_t> ints(3 * kMinElementsPerThread + 5);
+  for (auto& value : ints) {
+    value = generator();
+  }
+  std::vector<int32_t> expected_ints(ints);
+  std::sort(expected_ints.begin(), expected_ints.end(),
+            std::greater<int32_t>());
+  sort_->set_numa_topology(&three_nodes);
+  sort_->set_order(DESCENDING);
+  sort_->Sort(ints);
+  EXPECT_EQ(expected_ints, ints);
+
+  std::vector<uint64_t> narrow(2 * kMinElementsPerThread);
+  for (auto& value : narrow) {
+    value = generator() % 1000;
+  }
+  std::vector<uint64_t> expected_narrow(narrow);
+  std::sort(expected_narrow.begin(), expected_narrow.end());
+  sort_->set_order(ASCENDING);
+  sort_->Sort(narrow);
+  EXPECT_EQ(expected_narrow, narrow);
+
+  // The node buffers and node sorters are reused by the next sort of the
+  // same keys and count as scratch memory, the keys are held once in the
+  // node buffers and once in the node sorters' placeholders.
+  std::shuffle(narrow.begin(), narrow.end(), generator);
+  const int allocations = sort_->scratch_allocations();
+  sort_->Sort(narrow);
+  EXPECT_EQ(expected_narrow, narrow);
+  EXPECT_EQ(allocations, sort_->scratch_allocations());
+  EXPECT_LE(2 * narrow.size() * sizeof(uint64_t), sort_->scratch_bytes());
+  sort_->ReleaseScratch();
+  EXPECT_EQ(0u, sort_->scratch_bytes());
+  EXPECT_EQ(allocations, sort_->scratch_allocations());
+
+  // Threads that can't be pinned fall back to the parallel sort.
+  const NumaTopology unpinnable({{-1}, {-1}});
+  sort_->set_numa_topology(&unpinnable);
+  std::shuffle(narrow.begin(), narrow.end(), generator);
+  sort_->Sort(narrow);
+  EXPECT_EQ(expected_narrow, narrow);
+}
+
+TEST_F(RadixSortTest, TestParallelFloatSorting) {
+  // Tests that the parallel sort matches std::sort for floats.
+  std::mt19937 generator(13);
+  std::uniform_real_distribution<float> distribution(-1e6, 1e6);
+  std::vector<float> values(3 * kMinElementsPerThread + 5);
+  for (auto& value : values) {
+    value = distribution(generator);
+  }
+  std::vector<float> expected(values);
+  std::sort(expected.begin(), expected.end());
+  sort_->set_num_threads(3);
+  sort_->Sort(values);
+  EXPECT_EQ(expected, values);
+}
+
+TEST_F(RadixSortTest, TestParallelLongLongSorting) {
+  // Tests that the parallel sort matches std::sort for signed long longs.
+  std::mt19937_64 generator(13);
+  std::vector<int64_t> values(4 * kMinElementsPerThread + 3);
+  for (auto& value : values) {
+    value = generator();
+  }
+  std::vector<int64_t> expected(values);
+  std::sort(expected.begin(), expected.end());
+  sort_->set_num_threads(4);
+  sort_->Sort(values);
+  EXPECT_EQ(expected, values);
+}
+
+TEST_F(RadixSortTest, TestParallelDoubleSorting) {
+  // Tests that the parallel sort matches std::sort for doubles.
+  std::mt19937_64 generator(13);
+  std::normal_distribution<double> distribution(0, 1e12);
+  std::vector<double> values(2 * kMinElementsPerThread + 1);
+  for (auto& value : values) {
+    value = distribution(generator);
+  }
+  std::vector<double> expected(values);
+  std::sort(expected.begin(), expected.end());
+  sort_->set_num_threads(2);
+  sort_->Sort(values);
+  EXPECT_EQ(expected, values);
+}
+
+TEST_F(RadixSortTest, TestSortPairsSigned8BitKeys) {
+  // Tests that values follow their signed char keys.
+  std::vector<int8_t> keys({13, -123, 1, -11, 127, 113});
+  std::vector<int> values({0, 1, 2, 3, 4, 5});
+  std::vector<int8_t> expected_keys({-123, -11, 1, 13, 113, 127});
+  std::vector<int> expected_values({1, 3, 2, 0, 5, 4});
+  sort_->SortPairs(keys, values);
+  EXPECT_EQ(expected_keys, keys);
+  EXPECT_EQ(expected_values, values);
+}
+
+TEST_F(RadixSortTest, TestSortPairsFloatKeys) {
+  // Tests that values follow their float keys.
+  std::vector<float> keys({13, -123, 0.00001, -11.13, 127.127, 113});
+  std::vector<uint64_t> values({0, 1, 2, 3, 4, 5});
+  std::vector<float> expected_keys({-123, -11.13, 0.00001, 13, 113, 127.127});
+  std::vector<uint64_t> expected_values({1, 3, 2, 0, 5, 4});
+  sort_->SortPairs(keys, values);
+  EXPECT_EQ(expected_keys, keys);
+  EXPECT_EQ(expected_values, values);
+}
+
+TEST_F(RadixSortTest, TestSortPairsIsStable) {
+  // Tests that equal 64-bit keys keep the order of their values.
+  std::mt19937_64 generator(13);
+  std::vector<int64_t> keys(10000);
+  std::vector<std::pair<int64_t, int>> expected(keys.size());
+  for (int i = 0; i < keys.size(); ++i) {
+    keys[i] = static_cast<int64_t>(generator() % 100) - 50;
+    expected[i] = std::make_pair(keys[i], i);
+  }
+  std::vector<int> values(keys.size());
+  for (int i = 0; i < values.size(); ++i) {
+    values[i] = i;
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const std::pair<int64_t, int>& a,
+                      const std::pair<int64_t, int>& b) {
+                     return a.first < b.first;
+                   });
+  sort_->SortPairs(keys, values);
+  for (int i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(expected[i].first, keys[i]);
+    ASSERT_EQ(expected[i].second, values[i]);
+  }
+}
+
+TEST_F(RadixSortTest, TestSortPairsMismatchedSizes) {
+  // Tests that nothing is sorted when keys and values differ in size.
+  std::vector<uint32_t> keys({3, 2, 1});
+  std::vector<int> values({0, 1});
+  sort_->SortPairs(keys, values);
+  EXPECT_EQ(std::vector<uint32_t>({3, 2, 1}), keys);
+  EXPECT_EQ(std::vector<int>({0, 1}), values);
+}
+
+TEST_F(RadixSortTest, TestSortInterleavedPairs) {
+  // Tests sorting an interleaved vector of pairs by key.
+  std::vector<std::pair<int32_t, char>> pairs(
+      {{13, 'a'}, {-123, 'b'}, {1, 'c'}, {-11, 'd'}, {1, 'e'}, {113, 'f'}});
+  std::vector<std::pair<int32_t, char>> expected(
+      {{-123, 'b'}, {-11, 'd'}, {1, 'c'}, {1, 'e'}, {13, 'a'}, {113, 'f'}});
+  sort_->SortPairs(pairs);
+  EXPECT_EQ(expected, pairs);
+}
+
+TEST_F(RadixSortTest, TestArgSortDouble) {
+  // Tests that ArgSort returns the sorting permutation and keeps the keys.
+  const std::vector<double> values({13, -123, 0.00001, -11.13, 127.127, 113});
+  const std::vector<double> original(values);
+  std::vector<uint32_t> expected({1, 3, 2, 0, 5, 4});
+  EXPECT_EQ(expected, sort_->ArgSort(values));
+  EXPECT_EQ(original, values);
+}
+
+TEST_F(RadixSortTest, TestArgSort64BitIndices) {
+  // Tests that ArgSort with uint64_t indices matches a stable sort.
+  std::mt19937 generator(13);
+  std::vector<int16_t> values(5000);
+  for (auto& value : values) {
+    value = static_cast<int16_t>(generator());
+  }
+  std::vector<uint64_t> expected(values.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    expected[i] = i;
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [&values](const uint64_t a, const uint64_t b) {
+                     return values[a] < values[b];
+                   });
+  EXPECT_EQ(expected, (sort_->ArgSort<int16_t, uint64_t>(values)));
+}
+
+TEST_F(RadixSortTest, TestNarrowRangeSortingSkipsPasses) {
+  // Tests timestamps whose upper digits are constant, odd and even numbers
+  // of remaining passes.
+  std::mt19937_64 generator(13);
+  for (const uint64_t range : {1ULL << 11, 1ULL << 22, 1ULL << 33}) {
+    std::vector<uint64_t> values(1000);
+    for (auto& value : values) {
+      value = 1444000000000000000ULL + generator() % range;
+    }
+    std::vector<uint64_t> expected(values);
+    std::sort(expected.begin(), expected.end());
+    sort_->Sort(values);
+    EXPECT_EQ(expected, values);
+  }
+}
+
+TEST_F(RadixSortTest, TestNarrowRangeSignedSorting) {
+  // Tests small negative and positive values, the flop has to happen even
+  // though the upper passes are skipped.
+  std::vector<int32_t> values({13, -5, 1, -11, 7, 1000, -1000});
+  std::vector<int32_t> expected({-1000, -11, -5, 1, 7, 13, 1000});
+  sort_->Sort(values);
+  EXPECT_EQ(expected, values);
+}
+
+TEST_F(RadixSortTest, TestAllEqualSorting) {
+  // Tests arrays where every pass is skipped.
+  std::vector<double> doubles(10, -13.5);
+  sort_->Sort(doubles);
+  EXPECT_EQ(std::vector<double>(10, -13.5), doubles);
+  std::vector<int32_t> ints(10, -13);
+  sort_->Sort(ints);
+  EXPECT_EQ(std::vector<int32_t>(10, -13), ints);
+  std::vector<float> keys(3, 2.5);
+  std::vector<int> values({0, 1, 2});
+  sort_->SortPairs(keys, values);
+  EXPECT_EQ(std::vector<float>(3, 2.5), keys);
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), values);
+}
+
+TEST_F(RadixSortTest, TestParallelNarrowRangeSorting) {
+  // Tests that the parallel sort skips passes and still flops the result.
+  std::mt19937_64 generator(13);
+  std::vector<int64_t> values(2 * kMinElementsPerThread + 7);
+  for (auto& value : values) {
+    value = static_cast<int64_t>(generator() % 4096) - 2048;
+  }
+  std::vector<int64_t> expected(values);
+  std::sort(expected.begin(), expected.end());
+  sort_->set_num_threads(2);
+  sort_->Sort(values);
+  EXPECT_EQ(expected, values);
+}
+
+TEST_F(RadixSortTest, TestScratchIsReused) {
+  // Tests that repeated sorts of no larger arrays don't allocate.
+  std::mt19937_64 generator(13);
+  std::vector<int64_t> values(1000);
+  for (auto& value : values) {
+    value = generator();
+  }
+  std::vector<int64_t> expected(values);
+  std::sort(expected.begin(), expected.end());
+  std::vector<int64_t> copy(values);
+  sort_->Sort(copy);
+  const int allocations = sort_->scratch_allocations();
+  EXPECT_LT(0, allocations);
+  for (int i = 0; i < 3; ++i) {
+    copy = values;
+    sort_->Sort(copy);
+    EXPECT_EQ(expected, copy);
+  }
+  std::vector<double> smaller(500, 1.5);
+  sort_->Sort(smaller);
+  std::vector<uint32_t> keys(1000);
+  for (int i = 0; i < keys.size(); ++i) {
+    keys[i] = keys.size() - i;
+  }
+  std::vector<int64_t> payload(values);
+  sort_->SortPairs(keys, payload);
+  EXPECT_EQ(allocations + 1, sort_->scratch_allocations());  // Value buffer.
+  sort_->SortPairs(keys, payload);
+  EXPECT_EQ(allocations + 1, sort_->scratch_allocations());
+  std::vector<uint64_t> larger(values.begin(), values.end());
+  larger.insert(larger.end(), values.begin(), values.end());
+  sort_->Sort(larger);
+  EXPECT_EQ(allocations + 2, sort_->scratch_allocations());
+}
+
+TEST_F(RadixSortTest, TestReleaseScratch) {
+  // Tests that releasing the scratch memory frees it and sorting still works.
+  std::vector<int32_t> values({13, -123, 1, -11, 127, 113});
+  sort_->Sort(values);
+  EXPECT_LT(0, sort_->scratch_bytes());
+  sort_->ReleaseScratch();
+  EXPECT_EQ(0, sort_->scratch_bytes());
+  std::vector<int32_t> more({5, -5, 0});
+  sort_->Sort(more);
+  EXPECT_EQ(std::vector<int32_t>({-5, 0, 5}), more);
+}
+
+TEST_F(RadixSortTest, TestInPlaceSmallTypesSorting) {
+  // Tests the in-place sort on 8 and 16-bit types.
+  sort_->set_strategy(IN_PLACE_MSD);
+  std::vector<int8_t> chars({13, -123, 1, -11, 127, 113, 1});
+  sort_->Sort(chars);
+  EXPECT_EQ(std::vector<int8_t>({-123, -11, 1, 1, 13, 113, 127}), chars);
+  std::vector<uint16_t> shorts({13, 65535, 1, 11, 137, 113});
+  sort_->Sort(shorts);
+  EXPECT_EQ(std::vector<uint16_t>({1, 11, 13, 113, 137, 65535}), shorts);
+}
+
+TEST_F(RadixSortTest, TestInPlaceIntSorting) {
+  // Tests the in-place sort on random ints and floats.
+  std::mt19937 generator(13);
+  std::vector<int32_t> ints(100000);
+  for (auto& value : ints) {
+    value = generator();
+  }
+  std::vector<int32_t> expected_ints(ints);
+  std::sort(expected_ints.begin(), expected_ints.end());
+  std::uniform_real_distribution<float> distribution(-1e6, 1e6);
+  std::vector<float> floats(100000);
+  for (auto& value : floats) {
+    value = distribution(generator);
+  }
+  std::vector<float> expected_floats(floats);
+  std::sort(expected_floats.begin(), expected_floats.end());
+  sort_->set_strategy(IN_PLACE_MSD);
+  sort_->Sort(ints);
+  sort_->Sort(floats);
+  EXPECT_EQ(expected_ints, ints);
+  EXPECT_EQ(expected_floats, floats);
+}
+
+TEST_F(RadixSortTest, TestInPlaceLongLongSorting) {
+  // Tests the in-place sort on random, narrow range and duplicate values.
+  std::mt19937_64 generator(13);
+  for (const uint64_t range : {0ULL, 10ULL, 1ULL << 20, 1ULL << 40}) {
+    std::vector<int64_t> values(50000);
+    for (auto& value : values) {
+      value = range == 0 ? generator() : generator() % range - range / 2;
+    }
+    std::vector<int64_t> expected(values);
+    std::sort(expected.begin(), expected.end());
+    sort_->set_strategy(IN_PLACE_MSD);
+    sort_->Sort(values);
+    EXPECT_EQ(expected, values);
+  }
+}
+
+TEST_F(RadixSortTest, TestInPlaceDoubleSortingUsesLittleMemory) {
+  // Tests that the in-place sort only needs the histograms.
+  std::mt19937_64 generator(13);
+  std::normal_distribution<double> distribution(0, 1e12);
+  std::vector<double> values(1 << 17);
+  for (auto& value : values) {
+    value = distribution(generator);
+  }
+  std::vector<double> expected(values);
+  std::sort(expected.begin(), expected.end());
+  sort_->set_strategy(IN_PLACE_MSD);
+  sort_->Sort(values);
+  EXPECT_EQ(expected, values);
+  EXPECT_GE(6 * 2 * 2048 * sizeof(uint64_t), sort_->scratch_bytes());
+}
+
+TEST_F(RadixSortTest, TestHybridSortingAcrossSizes) {
+  // Tests the hybrid sort below, around and above the cutoffs.
+  std::mt19937_64 generator(13);
+  sort_->set_strategy(HYBRID);
+  for (const int size : {1, 16, 100, 512, 513, 5000, 100000}) {
+    std::vector<int64_t> longs(size);
+    std::vector<float> floats(size);
+    std::vector<int16_t> shorts(size);
+    for (int i = 0; i < size; ++i) {
+      longs[i] = generator();
+      floats[i] = static_cast<float>(static_cast<int64_t>(generator())) / 3;
+      shorts[i] = generator();
+    }
+    std::vector<int64_t> expected_longs(longs);
+    std::vector<float> expected_floats(floats);
+    std::vector<int16_t> expected_shorts(shorts);
+    std::sort(expected_longs.begin(), expected_longs.end());
+    std::sort(expected_floats.begin(), expected_floats.end());
+    std::sort(expected_shorts.begin(), expected_shorts.end());
+    sort_->Sort(longs);
+    sort_->Sort(floats);
+    sort_->Sort(shorts);
+    EXPECT_EQ(expected_longs, longs);
+    EXPECT_EQ(expected_floats, floats);
+    EXPECT_EQ(expected_shorts, shorts);
+  }
+}
+
+TEST_F(RadixSortTest, TestHybridSortingSkewed) {
+  // Tests a skewed input where one top digit bucket holds most values.
+  std::mt19937 generator(13);
+  std::vector<uint32_t> values(50000);
+  for (auto& value : values) {
+    value = generator() % 8 == 0 ? generator() : generator() % 100000;
+  }
+  std::vector<uint32_t> expected(values);
+  std::sort(expected.begin(), expected.end());
+  sort_->set_strategy(HYBRID);
+  sort_->Sort(values);
+  EXPECT_EQ(expected, values);
+}
+
+TEST_F(RadixSortTest, TestHybridSortingCutoffs) {
+  // Tests that the cutoffs are tunable, forcing every bucket through LSD or
+  // through insertion sort.
+  std::mt19937 generator(13);
+  std::vector<int32_t> values(20000);
+  for (auto& value : values) {
+    value = generator();
+  }
+  std::vector<int32_t> expected(values);
+  std::sort(expected.begin(), expected.end());
+  sort_->set_strategy(HYBRID);
+  sort_->set_comparison_sort_size(0);
+  sort_->set_insertion_sort_size(0);
+  EXPECT_EQ(0, sort_->comparison_sort_size());
+  std::vector<int32_t> radix_only(values);
+  sort_->Sort(radix_only);
+  EXPECT_EQ(expected, radix_only);
+  sort_->set_comparison_sort_size(100000);
+  sort_->set_insertion_sort_size(100000);
+  std::vector<int32_t> insertion_only(values);
+  sort_->Sort(insertion_only);
+  EXPECT_EQ(expected, insertion_only);
+}
+
+TEST_F(RadixSortTest, TestSimdLevelSorting) {
+  // Tests that opting into the vectorized histograms sorts the same.
+  EXPECT_EQ(SCALAR, sort_->simd_level());
+  sort_->set_simd_level(AVX2);
+  EXPECT_EQ(Histogram::SupportedSimdLevel(), sort_->simd_level());
+  std::mt19937_64 generator(13);
+  std::vector<int32_t> ints(100003);
+  std::vector<double> doubles(100003);
+  for (size_t i = 0; i < ints.size(); ++i) {
+    ints[i] = generator();
+    doubles[i] = static_cast<double>(static_cast<int64_t>(generator())) / 3;
+  }
+  std::vector<int32_t> expected_ints(ints);
+  std::vector<double> expected_doubles(doubles);
+  std::sort(expected_ints.begin(), expected_ints.end());
+  std::sort(expected_doubles.begin(), expected_doubles.end());
+  sort_->Sort(ints);
+  sort_->Sort(doubles);
+  EXPECT_EQ(expected_ints, ints);
+  EXPECT_EQ(expected_doubles, doubles);
+}
+
+TEST_F(RadixSortTest, TestBufferedScatterSorting) {
+  // Tests the line buffered scatters on every key kind, with sizes that leave
+  // partially filled lines behind.
+  std::mt19937_64 generator(13);
+  for (const ScatterMode mode : {BUFFERED, STREAMING}) {
+    sort_->set_scatter_mode(mode);
+    EXPECT_EQ(mode, sort_->scatter_mode());
+    for (const int size : {1, 15, 1000, 100003}) {
+      std::vector<uint32_t> unsigned_ints(size);
+      std::vector<int64_t> longs(size);
+      std::vector<float> floats(size);
+      std::vector<double> doubles(size);
+      for (int i = 0; i < size; ++i) {
+        unsigned_ints[i] = generator();
+        longs[i] = generator();
+        floats[i] = static_cast<float>(static_cast<int64_t>(generator())) / 3;
+        doubles[i] = static_cast<double>(static_cast<int64_t>(generator()));
+      }
+      std::vector<uint32_t> expected_unsigned_ints(unsigned_ints);
+      std::vector<int64_t> expected_longs(longs);
+      std::vector<float> expected_floats(floats);
+      std::vector<double> expected_doubles(doubles);
+      std::sort(expected_unsigned_ints.begin(), expected_unsigned_ints.end());
+      std::sort(expected_longs.begin(), expected_longs.end());
+      std::sort(expected_floats.begin(), expected_floats.end());
+      std::sort(expected_doubles.begin(), expected_doubles.end());
+      sort_->Sort(unsigned_ints);
+      sort_->Sort(longs);
+      sort_->Sort(floats);
+      sort_->Sort(doubles);
+      EXPECT_EQ(expected_unsigned_ints, unsigned_ints);
+      EXPECT_EQ(expected_longs, longs);
+      EXPECT_EQ(expected_floats, floats);
+      EXPECT_EQ(expected_doubles, doubles);
+    }
+  }
+}
+
+TEST_F(RadixSortTest, TestBufferedScatterIsStable) {
+  // Tests that equal low digits keep their order through the buffers, the
+  // high digit is sorted by the last pass only.
+  std::mt19937 generator(13);
+  std::vector<uint32_t> values(30000);
+  for (auto& value : values) {
+    value = (generator() % 3) << 22 | (generator() & 0x3fffff);
+  }
+  std::vector<uint32_t> expected(values);
+  std::sort(expected.begin(), expected.end());
+  sort_->set_scatter_mode(BUFFERED);
+  sort_->Sort(values);
+  EXPECT_EQ(expected, values);
+}
+
+TEST_F(RadixSortTest, TestSortDigitsWidths) {
+  // Tests every digit width on 32 and 64-bit signed and float keys.
+  std::mt19937_64 generator(13);
+  std::vector<int32_t> ints(5000);
+  std::vector<double> doubles(5000);
+  for (int i = 0; i < ints.size(); ++i) {
+    ints[i] = generator();
+    doubles[i] = static_cast<double>(static_cast<int64_t>(generator())) / 7;
+  }
+  std::vector<int32_t> expected_ints(ints);
+  std::vector<double> expected_doubles(doubles);
+  std::sort(expected_ints.begin(), expected_ints.end());
+  std::sort(expected_doubles.begin(), expected_doubles.end());
+  for (const int bits : {8, 11, 16}) {
+    std::vector<int32_t> sorted_ints(ints);
+    std::vector<double> sorted_doubles(doubles);
+    uint32_t* int_keys = reinterpret_cast<uint32_t*>(&sorted_ints[0]);
+    uint64_t* double_keys = reinterpret_cast<uint64_t*>(&sorted_doubles[0]);
+    if (bits == 8) {
+      sort_->SortDigits<8>(int_keys, ints.size(), SIGNED);
+      sort_->SortDigits<8>(double_keys, doubles.size(), FLOAT);
+    } else if (bits == 11) {
+      sort_->SortDigits<11>(int_keys, ints.size(), SIGNED);
+      sort_->SortDigits<11>(double_keys, doubles.size(), FLOAT);
+    } else {
+      sort_->SortDigits<16>(int_keys, ints.size(), SIGNED);
+      sort_->SortDigits<16>(double_keys, doubles.size(), FLOAT);
+    }
+    EXPECT_EQ(expected_ints, sorted_ints);
+    EXPECT_EQ(expected_doubles, sorted_doubles);
+  }
+}
+
+TEST_F(RadixSortTest, TestSetDigitBits) {
+  // Tests Sort with every digit width setting, including the buffered scatter
+  // over 16-bit digits and narrow values that skip passes.
+  std::mt19937 generator(13);
+  std::vector<uint64_t> values(20000);
+  for (auto& value : values) {
+    value = generator() % 3 == 0 ? generator() % 1000 : generator();
+  }
+  std::vector<uint64_t> expected(values);
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(kDefaultDigitBits, sort_->digit_bits());
+  for (const int bits : {8, 11, 16, kAutoDigitBits, 13}) {
+    for (const ScatterMode mode : {DIRECT, BUFFERED}) {
+      sort_->set_digit_bits(bits);
+      sort_->set_scatter_mode(mode);
+      std::vector<uint64_t> sorted(values);
+      sort_->Sort(sorted);
+      EXPECT_EQ(expected, sorted);
+    }
+  }
+}
+
+TEST_F(RadixSortTest, TestTunedDigitBits) {
+  // Tests that small arrays use narrow digits and huge ones wide digits only
+  // when their histograms fit in the cache.
+  sort_->set_cache_size(2 * 1024 * 1024);
+  EXPECT_EQ(8, sort_->TunedDigitBits(1000, 4));
+  EXPECT_EQ(11, sort_->TunedDigitBits(100000, 4));
+  EXPECT_EQ(16, sort_->TunedDigitBits(1 << 24, 4));
+  EXPECT_EQ(11, sort_->TunedDigitBits(1 << 24, 8));
+  sort_->set_cache_size(4 * 1024 * 1024);
+  EXPECT_EQ(16, sort_->TunedDigitBits(1 << 24, 8));
+  sort_->set_cache_size(256 * 1024);
+  EXPECT_EQ(11, sort_->TunedDigitBits(1 << 24, 4));
+}
+
+struct Trade {
+  uint32_t id;
+  double price;
+  int64_t timestamp;
+};
+
+struct Reading {
+  int32_t sensor;
+  float value;
+};
+
+struct LogEntry {
+  std::string message;
+  int64_t timestamp;
+};
+
+TEST_F(RadixSortTest, TestSortByKeyLargeRecords) {
+  // Tests records sorted through their indices, stable for equal keys.
+  std::mt19937_64 generator(13);
+  std::vector<Trade> trades(10000);
+  for (int i = 0; i < trades.size(); ++i) {
+    trades[i] = {static_cast<uint32_t>(i),
+                 static_cast<double>(static_cast<int64_t>(generator())) / 3,
+                 static_cast<int64_t>(generator() % 100) - 50};
+  }
+  std::vector<Trade> expected(trades);
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const Trade& a, const Trade& b) {
+                     return a.timestamp < b.timestamp;
+                   });
+  sort_->SortByKey(trades, [](const Trade& trade) { return trade.timestamp; });
+  for (int i = 0; i < trades.size(); ++i) {
+    EXPECT_EQ(expected[i].id, trades[i].id);
+  }
+  std::sort(expected.begin(), expected.end(),
+            [](const Trade& a, const Trade& b) { return a.price < b.price; });
+  sort_->SortByKey(trades, [](const Trade& trade) { return trade.price; });
+  for (int i = 0; i < trades.size(); ++i) {
+    EXPECT_EQ(expected[i].id, trades[i].id);
+  }
+}
+
+TEST_F(RadixSortTest, TestSortByKeySmallRecords) {
+  // Tests records carried with their keys, on a float key and a raw array.
+  std::mt19937 generator(13);
+  Reading readings[3000];
+  for (int i = 0; i < 3000; ++i) {
+    readings[i] = {i, static_cast<float>(static_cast<int32_t>(generator()))};
+  }
+  std::vector<Reading> expected(readings, readings + 3000);
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const Reading& a, const Reading& b) {
+                     return a.value < b.value;
+                   });
+  sort_->SortByKey(readings, 3000,
+                   [](const Reading& reading) { return reading.value; });
+  for (int i = 0; i < 3000; ++i) {
+    EXPECT_EQ(expected[i].sensor, readings[i].sensor);
+  }
+}
+
+TEST_F(RadixSortTest, TestSortByKeyNonTrivialRecords) {
+  // Tests that records which aren't trivially copyable are moved, not copied
+  // bitwise.
+  std::vector<LogEntry> entries(
+      {{"c", 30}, {"a", -10}, {"d", 30}, {"b", 20}, {"e", -10}});
+  sort_->SortByKey(entries, [](const LogEntry& entry) {
+    return entry.timestamp;
+  });
+  std::vector<std::string> messages;
+  for (const auto& entry : entries) {
+    messages.push_back(entry.message);
+  }
+  EXPECT_EQ(std::vector<std::string>({"a", "e", "b", "c", "d"}), messages);
+}
+
+TEST_F(RadixSortTest, TestArgSortColumns) {
+  // Tests mixed unsigned, signed and floating point columns against a stable
+  // sort of the rows, with few distinct values so later columns decide.
+  std::mt19937 generator(13);
+  std::vector<uint32_t> tenants(5000);
+  std::vector<int64_t> timestamps(5000);
+  std::vector<float> scores(5000);
+  for (int i = 0; i < tenants.size(); ++i) {
+    tenants[i] = generator() % 4;
+    timestamps[i] = static_cast<int64_t>(generator() % 8) - 4;
+    scores[i] = static_cast<float>(static_cast<int32_t>(generator() % 6)) - 3;
+  }
+  std::vector<uint32_t> expected(tenants.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    expected[i] = i;
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [&](const uint32_t a, const uint32_t b) {
+                     return std::make_tuple(tenants[a], timestamps[a],
+                                            scores[a]) <
+                            std::make_tuple(tenants[b], timestamps[b],
+                                            scores[b]);
+                   });
+  EXPECT_EQ(expected, sort_->ArgSortColumns(tenants, timestamps, scores));
+}
+
+TEST_F(RadixSortTest, TestArgSortColumnsConstantAndMismatched) {
+  // Tests that a constant column doesn't change the order and that columns of
+  // different sizes give an empty permutation.
+  std::vector<int32_t> constant({7, 7, 7, 7});
+  std::vector<double> values({2.5, -1.0, 2.5, 0.0});
+  EXPECT_EQ(std::vector<uint32_t>({1, 3, 0, 2}),
+            sort_->ArgSortColumns(constant, values));
+  EXPECT_EQ(std::vector<uint32_t>({1, 3, 0, 2}),
+            sort_->ArgSortColumns(values, constant));
+  std::vector<int8_t> shorter({1, 2});
+  EXPECT_TRUE(sort_->ArgSortColumns(values, shorter).empty());
+}
+
+TEST_F(RadixSortTest, TestSortByKeys) {
+  // Tests records sorted by two keys of different types.
+  std::vector<LogEntry> entries(
+      {{"c", 30}, {"b", -10}, {"a", 30}, {"b", -20}, {"a", -10}});
+  sort_->SortByKeys(
+      entries,
+      [](const LogEntry& entry) {
+        return static_cast<uint8_t>(entry.message[0]);
+      },
+      [](const LogEntry& entry) { return entry.timestamp; });
+  std::vector<std::string> messages;
+  std::vector<int64_t> timestamps;
+  for (const auto& entry : entries) {
+    messages.push_back(entry.message);
+    timestamps.push_back(entry.timestamp);
+  }
+  EXPECT_EQ(std::vector<std::string>({"a", "a", "b", "b", "c"}), messages);
+  EXPECT_EQ(std::vector<int64_t>({-10, 30, -20, -10, 30}), timestamps);
+}
+
+TEST_F(RadixSortTest, Test128BitSorting) {
+  // Tests unsigned and signed 128-bit integers on every digit width.
+  std::mt19937_64 generator(13);
+  std::vector<unsigned __int128> hashes(3000);
+  std::vector<__int128> values(3000);
+  for (int i = 0; i < hashes.size(); ++i) {
+    hashes[i] = static_cast<unsigned __int128>(generator()) << 64 | generator();
+    values[i] = static_cast<__int128>(static_cast<int64_t>(generator())) *
+                static_cast<int64_t>(generator() % 1000);
+  }
+  std::vector<unsigned __int128> expected_hashes(hashes);
+  std::vector<__int128> expected_values(values);
+  std::sort(expected_hashes.begin(), expected_hashes.end());
+  std::sort(expected_values.begin(), expected_values.end());
+  for (const int bits : {8, 11, 16}) {
+    sort_->set_digit_bits(bits);
+    std::vector<unsigned __int128> sorted_hashes(hashes);
+    std::vector<__int128> sorted_values(values);
+    sort_->Sort(sorted_hashes);
+    sort_->Sort(sorted_values);
+    EXPECT_TRUE(expected_hashes == sorted_hashes);
+    EXPECT_TRUE(expected_values == sorted_values);
+  }
+}
+
+TEST_F(RadixSortTest, TestByteKeySorting) {
+  // Tests that byte keys sort like memcmp, with a shared prefix and an odd
+  // number of active passes.
+  std::mt19937 generator(13);
+  std::vector<std::array<uint8_t, 20>> keys(5000);
+  for (auto& key : keys) {
+    for (int byte = 0; byte < 20; ++byte) {
+      key[byte] = byte < 4 ? 0xAB : generator();
+    }
+    key[19] = 0;
+  }
+  std::vector<std::array<uint8_t, 20>> expected(keys);
+  std::sort(expected.begin(), expected.end());
+  sort_->Sort(keys);
+  EXPECT_EQ(expected, keys);
+  std::vector<std::array<uint8_t, 3>> short_keys({{{3, 1, 2}}, {{1, 9, 9}},
+                                             {{3, 0, 255}}, {{1, 9, 8}}});
+  sort_->Sort(short_keys);
+  EXPECT_EQ((std::vector<std::array<uint8_t, 3>>(
+                {{{1, 9, 8}}, {{1, 9, 9}}, {{3, 0, 255}}, {{3, 1, 2}}})),
+            short_keys);
+}
+
+TEST_F(RadixSortTest, TestStringSorting) {
+  // Tests strings with long shared prefixes, empty strings, prefixes of each
+  // other and zero bytes, with and without insertion sorted buckets.
+  std::mt19937 generator(13);
+  std::vector<std::string> storage;
+  const std::string hosts[] = {"https://example.com/", "https://example.org/",
+                               "http://a.io/", ""};
+  for (int i = 0; i < 5000; ++i) {
+    std::string string = hosts[generator() % 4];
+    const int length = generator() % 30;
+    for (int j = 0; j < length; ++j) {
+      string += static_cast<char>(generator() % 4 == 0 ? 0 : 'a' + j % 3);
+    }
+    storage.push_back(string);
+  }
+  storage.push_back(std::string(40, 'x'));
+  storage.push_back(std::string(40, 'x') + "y");
+  storage.push_back(std::string(39, 'x'));
+  std::vector<std::string_view> strings(storage.begin(), storage.end());
+  std::vector<std::string_view> expected(strings);
+  std::sort(expected.begin(), expected.end());
+  for (const int insertion_sort_size : {kInsertionSortSize, 0}) {
+    sort_->set_insertion_sort_size(insertion_sort_size);
+    std::vector<std::string_view> sorted(strings);
+    sort_->Sort(sorted);
+    EXPECT_EQ(expected, sorted);
+  }
+}
+
+TEST_F(RadixSortTest, TestNestedPrefixStringSorting) {
+  // Tests strings that are all prefixes of each other, which sort one level
+  // deeper per string.
+  const std::string longest(10000, 'a');
+  std::vector<std::string_view> strings;
+  for (size_t length = 0; length <= longest.size(); ++length) {
+    strings.push_back(std::string_view(longest).substr(0, length));
+  }
+  std::vector<std::string_view> expected(strings);
+  std::shuffle(strings.begin(), strings.end(), std::mt19937(13));
+  std::vector<std::string_view> sorted(strings);
+  sort_->Sort(sorted);
+  EXPECT_EQ(expected, sorted);
+  sort_->set_order(DESCENDING);
+  sort_->Sort(strings);
+  EXPECT_EQ(std::vector<std::string_view>(expected.rbegin(), expected.rend()),
+            strings);
+}
+
+TEST_F(RadixSortTest, TestPresortedInput) {
+  // Tests that sorted and reversed input is finished without radix passes or
+  // scratch memory, duplicates and negative floats included.
+  std::vector<double> sorted({-7.5, -1, -1, 0, 2, 2, 2, 9.25, 1e9});
+  std::vector<double> values(sorted);
+  sort_->Sort(values);
+  EXPECT_EQ(sorted, values);
+  values.assign(sorted.rbegin(), sorted.rend());
+  sort_->Sort(values);
+  EXPECT_EQ(sorted, values);
+  std::vector<int64_t> longs(100000);
+  for (size_t i = 0; i < longs.size(); ++i) {
+    longs[i] = 50000 - static_cast<int64_t>(i / 3);
+  }
+  sort_->Sort(longs);
+  EXPECT_TRUE(std::is_sorted(longs.begin(), longs.end()));
+  EXPECT_EQ(0, sort_->scratch_allocations());
+
+  // The other strategies check too.
+  sort_->set_strategy(HYBRID);
+  std::reverse(longs.begin(), longs.end());
+  sort_->Sort(longs);
+  EXPECT_TRUE(std::is_sorted(longs.begin(), longs.end()));
+  EXPECT_EQ(0, sort_->scratch_allocations());
+}
+
+TEST_F(RadixSortTest, TestPresortedRuns) {
+  // Tests merging a few ascending runs, in both orders, and falling back to
+  // the radix sort with too many runs or the scan turned off.
+  std::mt19937 generator(23);
+  for (const int runs : {2, 5, 8, 9, 40}) {
+    for (const SortOrder order : {ASCENDING, DESCENDING}) {
+      std::vector<int32_t> values;
+      for (int run = 0; run < runs; ++run) {
+        std::vector<int32_t> part(1000 + run);
+        for (int32_t& value : part) {
+          value = static_cast<int32_t>(generator());
+        }
+        std::sort(part.begin(), part.end());
+        if (order == DESCENDING) {
+          std::reverse(part.begin(), part.end());
+        }
+        values.insert(values.end(), part.begin(), part.end());
+      }
+      std::vector<int32_t> expected(values);
+      std::sort(expected.begin(), expected.end());
+      if (order == DESCENDING) {
+        std::reverse(expected.begin(), expected.end());
+      }
+      RadixSort sort;
+      sort.set_order(order);
+      sort.Sort(values);
+      EXPECT_EQ(expected, values);
+      // The merge only needs the second buffer, radix sorts a histogram too.
+      EXPECT_EQ(runs <= kPresortedRuns ? 1 : 2, sort.scratch_allocations());
+    }
+  }
+  sort_->set_presorted_runs(0);
+  std::vector<uint32_t> sorted({1, 2, 3, 4});
+  sort_->Sort(sorted);
+  EXPECT_EQ(2, sort_->scratch_allocations());
+  sort_->set_presorted_runs(1000);
+  EXPECT_EQ(kMaxPresortedRuns, sort_->presorted_runs());
+}
+
+TEST_F(RadixSortTest, TestDescendingSorting) {
+  // Tests descending sorts of every key width and kind through every
+  // strategy, scatter and digit width, and with two threads.
+  std::mt19937_64 generator(13);
+  std::vector<int8_t> chars(1000);
+  std::vector<uint16_t> shorts(1000);
+  std::vector<int32_t> ints(140000);
+  std::vector<double> doubles(3000);
+  for (auto& value : chars) {
+    value = generator();
+  }
+  for (auto& value : shorts) {
+    value = generator();
+  }
+  for (auto& value : ints) {
+    value = generator() % 2 ? generator() : generator() % 100;
+  }
+  for (auto& value : doubles) {
+    value = static_cast<double>(static_cast<int64_t>(generator())) / 3;
+  }
+  std::vector<int8_t> expected_chars(chars);
+  std::vector<uint16_t> expected_shorts(shorts);
+  std::vector<int32_t> expected_ints(ints);
+  std::vector<double> expected_doubles(doubles);
+  std::sort(expected_chars.rbegin(), expected_chars.rend());
+  std::sort(expected_shorts.rbegin(), expected_shorts.rend());
+  std::sort(expected_ints.rbegin(), expected_ints.rend());
+  std::sort(expected_doubles.rbegin(), expected_doubles.rend());
+  sort_->set_order(DESCENDING);
+  EXPECT_EQ(DESCENDING, sort_->order());
+  for (const SortStrategy strategy : {LSD, IN_PLACE_MSD, HYBRID}) {
+    for (const int bits : {8, 11, 16}) {
+      for (const ScatterMode mode : {DIRECT, BUFFERED}) {
+        sort_->set_strategy(strategy);
+        sort_->set_digit_bits(bits);
+        sort_->set_scatter_mode(mode);
+        std::vector<int8_t> sorted_chars(chars);
+        std::vector<uint16_t> sorted_shorts(shorts);
+        std::vector<int32_t> sorted_ints(ints);
+        std::vector<double> sorted_doubles(doubles);
+        sort_->Sort(sorted_chars);
+        sort_->Sort(sorted_shorts);
+        sort_->Sort(sorted_ints);
+        sort_->Sort(sorted_doubles);
+        EXPECT_EQ(expected_chars, sorted_chars);
+        EXPECT_EQ(expected_shorts, sorted_shorts);
+        EXPECT_EQ(expected_ints, sorted_ints);
+        EXPECT_EQ(expected_doubles, sorted_doubles);
+      }
+    }
+  }
+  RadixSort parallel(2);
+  parallel.set_order(DESCENDING);
+  std::vector<int32_t> sorted_ints(ints);
+  parallel.Sort(sorted_ints);
+  EXPECT_EQ(expected_ints, sorted_ints);
+}
+
+TEST_F(RadixSortTest, TestDescendingIsStable) {
+  // Tests that equal keys keep their order in descending pair sorts.
+  std::mt19937 generator(13);
+  std::vector<uint32_t> keys(10000);
+  std::vector<int> values(keys.size());
+  for (int i = 0; i < keys.size(); ++i) {
+    keys[i] = generator() % 50;
+    values[i] = i;
+  }
+  std::vector<std::pair<uint32_t, int>> expected;
+  for (int i = 0; i < keys.size(); ++i) {
+    expected.emplace_back(keys[i], values[i]);
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const std::pair<uint32_t, int>& a,
+                      const std::pair<uint32_t, int>& b) {
+                     return a.first > b.first;
+                   });
+  sort_->set_order(DESCENDING);
+  sort_->SortPairs(keys, values);
+  for (int i = 0; i < keys.size(); ++i) {
+    EXPECT_EQ(expected[i].first, keys[i]);
+    EXPECT_EQ(expected[i].second, values[i]);
+  }
+}
+
+TEST_F(RadixSortTest, TestDescendingStringAndByteKeySorting) {
+  // Tests descending strings, longer strings before their prefixes, and
+  // descending byte keys.
+  std::vector<std::string_view> strings(
+      {"b", "abc", "", "ab", "abd", "b", "a"});
+  sort_->set_order(DESCENDING);
+  sort_->set_insertion_sort_size(0);
+  sort_->Sort(strings);
+  EXPECT_EQ(std::vector<std::string_view>(
+                {"b", "b", "abd", "abc", "ab", "a", ""}),
+            strings);
+  std::vector<std::array<uint8_t, 2>> keys({{{1, 2}}, {{3, 0}}, {{1, 9}}});
+  sort_->Sort(keys);
+  EXPECT_EQ((std::vector<std::array<uint8_t, 2>>({{{3, 0}}, {{1, 9}},
+                                                  {{1, 2}}})),
+            keys);
+}
+
+TEST_F(RadixSortTest, TestSelect) {
+  // Tests that Select places the k-th element with smaller ones in front and
+  // larger ones behind, for several k, key kinds and k out of range.
+  std::mt19937_64 generator(13);
+  std::vector<double> doubles(20000);
+  std::vector<int16_t> shorts(20000);
+  for (int i = 0; i < doubles.size(); ++i) {
+    doubles[i] = static_cast<double>(static_cast<int64_t>(generator())) / 3;
+    shorts[i] = generator() % 100;
+  }
+  std::vector<double> sorted_doubles(doubles);
+  std::vector<int16_t> sorted_shorts(shorts);
+  std::sort(sorted_doubles.begin(), sorted_doubles.end());
+  std::sort(sorted_shorts.begin(), sorted_shorts.end());
+  for (const int k : {0, 1, 999, 10000, 19999}) {
+    std::vector<double> selected_doubles(doubles);
+    std::vector<int16_t> selected_shorts(shorts);
+    EXPECT_EQ(sorted_doubles[k], sort_->Select(selected_doubles, k));
+    EXPECT_EQ(sorted_shorts[k], sort_->Select(selected_shorts, k));
+    for (int i = 0; i < doubles.size(); ++i) {
+      EXPECT_EQ(i < k, selected_doubles[i] < sorted_doubles[k]);
+      if (i < k) {  // Few distinct shorts, equal ones may be on either side.
+        EXPECT_LE(selected_shorts[i], sorted_shorts[k]);
+      } else {
+        EXPECT_GE(selected_shorts[i], sorted_shorts[k]);
+      }
+    }
+  }
+
+  // Out of range k is clamped, an empty array has nothing to select.
+  std::vector<double> selected(doubles);
+  EXPECT_EQ(sorted_doubles.back(), sort_->Select(selected, doubles.size()));
+  EXPECT_EQ(sorted_doubles.front(), sort_->Select(selected, -5));
+  std::vector<int16_t> empty;
+  EXPECT_EQ(0, sort_->Select(empty, 0));
+}
+
+TEST_F(RadixSortTest, TestPartialSortAndTopK) {
+  // Tests that the first k elements come out sorted, ascending and
+  // descending, with the original array kept by TopK.
+  std::mt19937 generator(13);
+  std::vector<int32_t> values(50000);
+  for (auto& value : values) {
+    value = generator();
+  }
+  std::vector<int32_t> ascending(values);
+  std::vector<int32_t> descending(values);
+  std::sort(ascending.begin(), ascending.end());
+  std::sort(descending.rbegin(), descending.rend());
+  for (const int k : {0, 10, 1000, 50000, 60000}) {
+    const int count = std::min<int>(k, values.size());
+    std::vector<int32_t> partial(values);
+    sort_->set_order(ASCENDING);
+    sort_->PartialSort(partial, k);
+    EXPECT_TRUE(
+        std::equal(ascending.begin(), ascending.begin() + count,
+                   partial.begin()));
+    sort_->set_order(DESCENDING);
+    const std::vector<int32_t> top = sort_->TopK(values, k);
+    EXPECT_EQ(std::vector<int32_t>(descending.begin(),
+                                   descending.begin() + count),
+              top);
+  }
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
@@ -0,0 +1,56 @@
+// Copyright 2015 Kevin Melkowski
+
+#ifndef SCRATCH_BUFFER_H_
+#define SCRATCH_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Growable raw memory reused across sorts.  It only ever grows, so repeated
+// sorts of similar sizes stop allocating after the first one.  The memory is
+// uninitialized and only meant for trivially copyable types.
+class ScratchBuffer {
+ public:
+  ScratchBuffer() : capacity_(0), allocations_(0) {}
+
+  // Returns room for count elements of T, reallocating only if the buffer is
+  // too small.  Previous contents are not kept when it grows.
+  template <typename T>
+  T* Get(const size_t count);
+
+  // Free the memory, the next Get allocates again.
+  void Release();
+
+  // Bytes currently held.
+  size_t capacity() const { return capacity_; }
+
+  // Number of times memory was allocated since construction.
+  int allocations() const { return allocations_; }
+
+ private:
+  std::unique_ptr<std::max_align_t[]> data_;
+  size_t capacity_;
+  int allocations_;
+};
+
+template <typename T>
+T* ScratchBuffer::Get(const size_t count) {
+  // Grow to the requested size, rounded up to whole max_align_t blocks.
+  const size_t bytes = count * sizeof(T);
+  if (bytes > capacity_) {
+    const size_t blocks =
+        (bytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+    data_.reset(new std::max_align_t[blocks]);
+    capacity_ = blocks * sizeof(std::max_align_t);
+    ++allocations_;
+  }
+  return reinterpret_cast<T*>(data_.get());
+}
+
+void ScratchBuffer::Release() {
+  data_.reset();
+  capacity_ = 0;
+}
+
+#endif  // SCRATCH_BUFFER_H_
@@ -0,0 +1,55 @@
+// Copyright 2015 Kevin Melkowski
+
+#include "sort/radix_sort/scratch_buffer.h"
+
+#include <stdint.h>
+
+#include <memory>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class ScratchBufferTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() { buffer_.reset(new ScratchBuffer); }
+  std::unique_ptr<ScratchBuffer> buffer_;
+};
+
+TEST_F(ScratchBufferTest, TestEmpty) {
+  // Tests that a new buffer holds nothing.
+  EXPECT_EQ(0, buffer_->capacity());
+  EXPECT_EQ(0, buffer_->allocations());
+}
+
+TEST_F(ScratchBufferTest, TestGetOnlyGrows) {
+  // Tests that the buffer only allocates when asked for more than it holds.
+  uint64_t* first = buffer_->Get<uint64_t>(100);
+  EXPECT_LE(100 * sizeof(uint64_t), buffer_->capacity());
+  EXPECT_EQ(1, buffer_->allocations());
+  EXPECT_EQ(first, buffer_->Get<uint64_t>(50));
+  EXPECT_EQ(first, reinterpret_cast<uint64_t*>(buffer_->Get<uint8_t>(800)));
+  EXPECT_EQ(1, buffer_->allocations());
+  buffer_->Get<uint64_t>(101);
+  EXPECT_LE(101 * sizeof(uint64_t), buffer_->capacity());
+  EXPECT_EQ(2, buffer_->allocations());
+}
+
+TEST_F(ScratchBufferTest, TestRelease) {
+  // Tests that Release frees the memory and the next Get allocates again.
+  buffer_->Get<uint32_t>(10);
+  buffer_->Release();
+  EXPECT_EQ(0, buffer_->capacity());
+  buffer_->Get<uint32_t>(10);
+  EXPECT_EQ(2, buffer_->allocations());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,220 @@
+// Copyright 2015 Kevin Melkowski
+//
+// RadixSort::Sort against std::sort and std::stable_sort for every supported
+// type, sizes from 10 up and a range of input distributions.  Sizes stop at
+// 10^7 unless RADIX_SORT_BENCHMARK_MAX_SIZE raises them, e.g. to 1000000000.
+// Every result reports elements and bytes per second, for machine readable
+// output run with --benchmark_format=json or --benchmark_out=FILE
+// --benchmark_out_format=json.
+
+#include "sort/radix_sort/radix_sort.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+// Input distributions.
+//   UNIFORM: Random bit patterns, for floats random values in +-1e6.
+//   SORTED, REVERSE: Uniform values already in order or in reverse order.
+//   FEW_UNIQUE: Uniform picks from 16 distinct values.
+//   ZIPF: Zipf-like skew, value k with probability about k^-1.1.
+//   NARROW_RANGE: Uniform in [0, 1000) on top of a large constant, like
+//        timestamps within a second.
+//   SPECIAL_FLOATS: Floats with a tenth each of NaNs, denormals, zeros of
+//        both signs and infinities.  The std sorts put NaNs last so their
+//        comparisons stay a strict weak ordering.
+enum Distribution {
+  UNIFORM,
+  SORTED,
+  REVERSE,
+  FEW_UNIQUE,
+  ZIPF,
+  NARROW_RANGE,
+  SPECIAL_FLOATS
+};
+
+const char* const kDistributionNames[] = {
+    "uniform", "sorted",       "reverse",       "few_unique",
+    "zipf",    "narrow_range", "special_floats"};
+
+// Sorts compared.
+enum Sorter { RADIX_SORT, STD_SORT, STD_STABLE_SORT };
+
+const char* const kSorterNames[] = {"radix_sort", "std::sort",
+                                    "std::stable_sort"};
+
+// Small arrays are sorted this many elements at a time per iteration, so
+// pausing the timer to reset the input doesn't dominate.
+const int kMinElementsPerIteration = 1 << 16;
+
+template <typename T>
+T Uniform(std::mt19937_64* generator) {
+  if (std::is_floating_point<T>::value) {
+    return static_cast<T>(
+        std::uniform_real_distribution<double>(-1e6, 1e6)(*generator));
+  }
+  return static_cast<T>((*generator)());
+}
+
+template <typename T>
+T Special(std::mt19937_64* generator) {
+  // Uniform values with a tenth of each special value mixed in.
+  switch ((*generator)() % 10) {
+    case 0:
+      return std::numeric_limits<T>::quiet_NaN();
+    case 1:
+      return std::numeric_limits<T>::denorm_min() * ((*generator)() % 1000);
+    case 2:
+      return (*generator)() % 2 ? T(0) : -T(0);
+    case 3:
+      return (*generator)() % 2 ? std::numeric_limits<T>::infinity()
+                                : -std::numeric_limits<T>::infinity();
+    default:
+      return Uniform<T>(generator);
+  }
+}
+
+template <typename T>
+bool NanLast(const T a, const T b) {
+  return a < b || (std::isnan(b) && !std::isnan(a));
+}
+
+template <typename T>
+std::vector<T> Generate(const Distribution distribution, const int64_t size,
+                        const int64_t batches) {
+  // batches consecutive arrays of size elements, fixed seed so runs are
+  // comparable.
+  std::mt19937_64 generator(13);
+  std::vector<T> values(size * batches);
+  T few[16];
+  for (T& value : few) {
+    value = Uniform<T>(&generator);
+  }
+  for (T& value : values) {
+    switch (distribution) {
+      case FEW_UNIQUE:
+        value = few[generator() % 16];
+        break;
+      case ZIPF: {
+        // Discretized Pareto, heavy on small values like Zipf.
+        const double u = std::generate_canonical<double, 53>(generator);
+        const double rank = std::floor(std::pow(1.0 - u, -1.0 / 0.1));
+        value = static_cast<T>(static_cast<uint64_t>(std::min(rank, 1e18)));
+        break;
+      }
+      case NARROW_RANGE:
+        value = static_cast<T>(std::is_floating_point<T>::value
+                                   ? 1e6 + generator() % 1000
+                                   : 0x5400000000000000ULL +
+                                         generator() % 1000);
+        break;
+      case SPECIAL_FLOATS:
+        value = Special<T>(&generator);
+        break;
+      default:
+        value = Uniform<T>(&generator);
+    }
+  }
+  if (distribution == SORTED || distribution == REVERSE) {
+    for (int64_t batch = 0; batch < batches; ++batch) {
+      T* begin = values.data() + batch * size;
+      std::sort(begin, begin + size);
+      if (distribution == REVERSE) {
+        std::reverse(begin, begin + size);
+      }
+    }
+  }
+  return values;
+}
+
+template <typename T>
+void BM_Sort(benchmark::State& state) {
+  // Sorts state.range(0) elements of Distribution state.range(1) with Sorter
+  // state.range(2).
+  const int64_t size = state.range(0);
+  const Distribution distribution = static_cast<Distribution>(state.range(1));
+  const Sorter sorter = static_cast<Sorter>(state.range(2));
+  const int64_t batches = std::max<int64_t>(1, kMinElementsPerIteration / size);
+  const std::vector<T> input = Generate<T>(distribution, size, batches);
+  RadixSort sort;
+  std::vector<T> values;
+  for (auto _ : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    for (int64_t batch = 0; batch < batches; ++batch) {
+      T* begin = values.data() + batch * size;
+      if (sorter == RADIX_SORT) {
+        sort.Sort(begin, size);
+      } else if (distribution == SPECIAL_FLOATS && sorter == STD_SORT) {
+        std::sort(begin, begin + size, NanLast<T>);
+      } else if (distribution == SPECIAL_FLOATS) {
+        std::stable_sort(begin, begin + size, NanLast<T>);
+      } else if (sorter == STD_SORT) {
+        std::sort(begin, begin + size);
+      } else {
+        std::stable_sort(begin, begin + size);
+      }
+    }
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+  state.SetBytesProcessed(state.iterations() * input.size() * sizeof(T));
+  state.SetLabel(std::string(kDistributionNames[distribution]) + "/" +
+                 kSorterNames[sorter]);
+}
+
+template <typename T>
+void SizesDistributionsAndSorters(benchmark::internal::Benchmark* benchmark) {
+  // Sizes 10, 1000, ... up to 10^7 or RADIX_SORT_BENCHMARK_MAX_SIZE, every
+  // distribution that applies to T and every sorter.
+  int64_t max_size = 10000000;
+  if (const char* max = std::getenv("RADIX_SORT_BENCHMARK_MAX_SIZE")) {
+    max_size = std::atoll(max);
+  }
+  const int distributions =
+      std::is_floating_point<T>::value ? SPECIAL_FLOATS + 1 : SPECIAL_FLOATS;
+  for (int64_t size = 10; size <= max_size; size *= 100) {
+    for (int distribution = 0; distribution < distributions; ++distribution) {
+      for (const int sorter : {RADIX_SORT, STD_SORT, STD_STABLE_SORT}) {
+        benchmark->Args({size, distribution, sorter});
+      }
+    }
+  }
+  benchmark->ArgNames({"size", "distribution", "sorter"});
+}
+
+BENCHMARK_TEMPLATE(BM_Sort, int8_t)
+    ->Apply(SizesDistributionsAndSorters<int8_t>);
+BENCHMARK_TEMPLATE(BM_Sort, uint8_t)
+    ->Apply(SizesDistributionsAndSorters<uint8_t>);
+BENCHMARK_TEMPLATE(BM_Sort, int16_t)
+    ->Apply(SizesDistributionsAndSorters<int16_t>);
+BENCHMARK_TEMPLATE(BM_Sort, uint16_t)
+    ->Apply(SizesDistributionsAndSorters<uint16_t>);
+BENCHMARK_TEMPLATE(BM_Sort, int32_t)
+    ->Apply(SizesDistributionsAndSorters<int32_t>);
+BENCHMARK_TEMPLATE(BM_Sort, uint32_t)
+    ->Apply(SizesDistributionsAndSorters<uint32_t>);
+BENCHMARK_TEMPLATE(BM_Sort, int64_t)
+    ->Apply(SizesDistributionsAndSorters<int64_t>);
+BENCHMARK_TEMPLATE(BM_Sort, uint64_t)
+    ->Apply(SizesDistributionsAndSorters<uint64_t>);
+BENCHMARK_TEMPLATE(BM_Sort, float)->Apply(SizesDistributionsAndSorters<float>);
+BENCHMARK_TEMPLATE(BM_Sort, double)
+    ->Apply(SizesDistributionsAndSorters<double>);
+
+}  // namespace
+
+BENCHMARK_MAIN();
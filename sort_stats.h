@@ -0,0 +1,235 @@
+// Copyright 2015 Kevin Melkowski
+
+#ifndef SORT_STATS_H_
+#define SORT_STATS_H_
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <cstring>
+
+// Phases of a sort that SortStats times.
+//   HISTOGRAM_PHASE: Counting digits, including flipping signed and floating
+//        point values.
+//   PREFIX_SUM_PHASE: Turning the counts into bucket offsets.
+//   SCATTER_PHASE: The digit passes, including the flop fused into the last.
+//   COPY_PHASE: Copying back after an odd number of passes and flopping
+//        when no pass was left to fuse it into.
+enum SortPhase {
+  HISTOGRAM_PHASE,
+  PREFIX_SUM_PHASE,
+  SCATTER_PHASE,
+  COPY_PHASE,
+  NUM_SORT_PHASES
+};
+
+// Where the time and memory traffic of sorts went, accumulated over every
+// sort until Reset.  Filled in through RadixSort::set_stats only when built
+// with RADIX_SORT_STATS defined, otherwise the hooks compile to nothing and
+// the counts stay zero.  Phases are exclusive, a prefix sum inside a
+// histogram phase is only counted as a prefix sum.  Not thread safe, parallel
+// sorts are timed from the calling thread.
+class SortStats {
+ public:
+  SortStats();
+  ~SortStats();
+
+  // Zero every count, hardware counters stay open.
+  void Reset();
+
+  // Also count last level cache and data TLB misses per phase with Linux
+  // perf_event_open.  Returns false if the counters aren't available, e.g.
+  // off Linux, in a VM or under a restrictive perf_event_paranoid.
+  bool EnableHardwareCounters();
+  bool hardware_counters() const { return cache_fd_ >= 0; }
+
+  // Entered and left through SortPhaseScope.
+  void EnterPhase(const SortPhase phase);
+  void LeavePhase();
+
+  // Wall time, cache and TLB misses per phase.
+  double seconds[NUM_SORT_PHASES];
+  uint64_t cache_misses[NUM_SORT_PHASES];
+  uint64_t tlb_misses[NUM_SORT_PHASES];
+
+  // Sorts and elements sorted.
+  int64_t sorts;
+  int64_t elements;
+
+  // Bytes written by scatter passes, copies and flops.
+  int64_t bytes_moved;
+
+  // Digit passes scattered and skipped because every element had the same
+  // digit.
+  int64_t passes;
+  int64_t passes_skipped;
+
+  // Largest scratch memory held by the sorter after a sort.
+  size_t scratch_bytes;
+
+ private:
+  // Charge the time and misses since the last transition to the active
+  // phase.
+  void Charge();
+
+  // Read a hardware counter, 0 if it isn't open.
+  static uint64_t ReadCounter(const int fd);
+
+  static const int kMaxDepth = 8;
+  SortPhase stack_[kMaxDepth];
+  int depth_;
+  std::chrono::steady_clock::time_point last_;
+  uint64_t last_cache_;
+  uint64_t last_tlb_;
+  int cache_fd_;
+  int tlb_fd_;
+};
+
+// Times a phase for as long as it is in scope, nothing if stats is null.
+class SortPhaseScope {
+ public:
+  SortPhaseScope(SortStats* stats, const SortPhase phase) : stats_(stats) {
+    if (stats_ != nullptr) {
+      stats_->EnterPhase(phase);
+    }
+  }
+  ~SortPhaseScope() {
+    if (stats_ != nullptr) {
+      stats_->LeavePhase();
+    }
+  }
+
+ private:
+  SortStats* stats_;
+};
+
+// Hooks in the sort code, compiled out unless RADIX_SORT_STATS is defined.
+// RADIX_SORT_PHASE(stats, phase) times the rest of the enclosing scope and
+// RADIX_SORT_COUNT(stats, field, amount) adds to a count.
+#ifdef RADIX_SORT_STATS
+#define RADIX_SORT_PHASE_NAME(line) sort_phase_scope_##line
+#define RADIX_SORT_PHASE_AT(line, stats, phase) \
+  SortPhaseScope RADIX_SORT_PHASE_NAME(line)(stats, phase)
+#define RADIX_SORT_PHASE(stats, phase) \
+  RADIX_SORT_PHASE_AT(__LINE__, stats, phase)
+#define RADIX_SORT_COUNT(stats, field, amount) \
+  do {                                         \
+    if ((stats) != nullptr) {                  \
+      (stats)->field += (amount);              \
+    }                                          \
+  } while (0)
+#else
+#define RADIX_SORT_PHASE(stats, phase) \
+  do {                                 \
+  } while (0)
+#define RADIX_SORT_COUNT(stats, field, amount) \
+  do {                                         \
+  } while (0)
+#endif
+
+SortStats::SortStats() : depth_(0), cache_fd_(-1), tlb_fd_(-1) { Reset(); }
+
+SortStats::~SortStats() {
+#if defined(__linux__)
+  if (cache_fd_ >= 0) {
+    close(cache_fd_);
+  }
+  if (tlb_fd_ >= 0) {
+    close(tlb_fd_);
+  }
+#endif
+}
+
+void SortStats::Reset() {
+  std::memset(seconds, 0, sizeof(seconds));
+  std::memset(cache_misses, 0, sizeof(cache_misses));
+  std::memset(tlb_misses, 0, sizeof(tlb_misses));
+  sorts = 0;
+  elements = 0;
+  bytes_moved = 0;
+  passes = 0;
+  passes_skipped = 0;
+  scratch_bytes = 0;
+}
+
+bool SortStats::EnableHardwareCounters() {
+#if defined(__linux__)
+  if (cache_fd_ >= 0) {
+    return true;
+  }
+  // Counts this thread only, in user space.
+  perf_event_attr attributes;
+  std::memset(&attributes, 0, sizeof(attributes));
+  attributes.size = sizeof(attributes);
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  attributes.type = PERF_TYPE_HARDWARE;
+  attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+  cache_fd_ = syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+  attributes.type = PERF_TYPE_HW_CACHE;
+  attributes.config = PERF_COUNT_HW_CACHE_DTLB |
+                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  tlb_fd_ = syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+  if (cache_fd_ < 0 || tlb_fd_ < 0) {
+    if (cache_fd_ >= 0) {
+      close(cache_fd_);
+    }
+    if (tlb_fd_ >= 0) {
+      close(tlb_fd_);
+    }
+    cache_fd_ = -1;
+    tlb_fd_ = -1;
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+void SortStats::EnterPhase(const SortPhase phase) {
+  Charge();
+  if (depth_ < kMaxDepth) {
+    stack_[depth_] = phase;
+  }
+  ++depth_;
+}
+
+void SortStats::LeavePhase() {
+  Charge();
+  --depth_;
+}
+
+void SortStats::Charge() {
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  const uint64_t cache = ReadCounter(cache_fd_);
+  const uint64_t tlb = ReadCounter(tlb_fd_);
+  if (depth_ > 0 && depth_ <= kMaxDepth) {
+    const SortPhase phase = stack_[depth_ - 1];
+    seconds[phase] += std::chrono::duration<double>(now - last_).count();
+    cache_misses[phase] += cache - last_cache_;
+    tlb_misses[phase] += tlb - last_tlb_;
+  }
+  last_ = now;
+  last_cache_ = cache;
+  last_tlb_ = tlb;
+}
+
+uint64_t SortStats::ReadCounter(const int fd) {
+  uint64_t value = 0;
+#if defined(__linux__)
+  if (fd >= 0 && read(fd, &value, sizeof(value)) != sizeof(value)) {
+    value = 0;
+  }
+#endif
+  return value;
+}
+
+#endif  // SORT_STATS_H_
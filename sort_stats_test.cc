@@ -0,0 +1,142 @@
+// Copyright 2015 Kevin Melkowski
+
+// The hooks are compiled out unless this is defined before the headers.
+#define RADIX_SORT_STATS 1
+
+#include "sort/radix_sort/sort_stats.h"
+
+#include <stdint.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "sort/radix_sort/radix_sort.h"
+
+namespace {
+
+class SortStatsTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    sort_.reset(new RadixSort);
+    sort_->set_stats(&stats_);
+  }
+
+  template <typename T>
+  std::vector<T> RandomValues(const int size, const uint64_t mask) {
+    std::mt19937_64 generator(29);
+    std::vector<T> values(size);
+    for (T& value : values) {
+      value = static_cast<T>(generator() & mask);
+    }
+    return values;
+  }
+
+  SortStats stats_;
+  std::unique_ptr<RadixSort> sort_;
+};
+
+TEST_F(SortStatsTest, TestNestedPhasesAreExclusive) {
+  // Tests that time in an inner phase isn't charged to the outer one too.
+  SortStats stats;
+  {
+    SortPhaseScope outer(&stats, HISTOGRAM_PHASE);
+    SortPhaseScope inner(&stats, PREFIX_SUM_PHASE);
+    volatile int spin = 0;
+    for (int i = 0; i < 1000000; ++i) {
+      spin = spin + 1;
+    }
+  }
+  EXPECT_LT(stats.seconds[HISTOGRAM_PHASE], stats.seconds[PREFIX_SUM_PHASE]);
+  EXPECT_EQ(0, stats.seconds[SCATTER_PHASE]);
+  stats.Reset();
+  EXPECT_EQ(0, stats.seconds[PREFIX_SUM_PHASE]);
+}
+
+TEST_F(SortStatsTest, TestThreePassSort) {
+  // Tests the phases and traffic of an 11-bit LSD sort of 32-bit keys: a copy
+  // of the keys while counting and three scatters, the last one back into the
+  // array.
+  const int size = 1 << 18;
+  std::vector<uint32_t> values = RandomValues<uint32_t>(size, ~0ULL);
+  sort_->Sort(values);
+  EXPECT_EQ(1, stats_.sorts);
+  EXPECT_EQ(size, stats_.elements);
+  EXPECT_EQ(3, stats_.passes);
+  EXPECT_EQ(0, stats_.passes_skipped);
+  EXPECT_EQ(4 * size * sizeof(uint32_t), stats_.bytes_moved);
+  EXPECT_LT(0, stats_.seconds[HISTOGRAM_PHASE]);
+  EXPECT_LT(0, stats_.seconds[PREFIX_SUM_PHASE]);
+  EXPECT_LT(0, stats_.seconds[SCATTER_PHASE]);
+  EXPECT_EQ(0, stats_.seconds[COPY_PHASE]);
+  EXPECT_LE(size * sizeof(uint32_t), stats_.scratch_bytes);
+}
+
+TEST_F(SortStatsTest, TestSkippedPasses) {
+  // Tests that passes over constant digits are counted as skipped.
+  std::vector<uint64_t> values = RandomValues<uint64_t>(10000, 0x7FF);
+  sort_->Sort(values);
+  EXPECT_EQ(1, stats_.passes);
+  EXPECT_EQ(5, stats_.passes_skipped);
+  EXPECT_EQ(2 * 10000 * sizeof(uint64_t), stats_.bytes_moved);
+  // Sorted input is caught by the presorted scan, no passes at all.
+  sort_->Sort(values);
+  EXPECT_EQ(2, stats_.sorts);
+  EXPECT_EQ(1, stats_.passes);
+}
+
+TEST_F(SortStatsTest, TestSmallKeysAndThreads) {
+  // Tests the 8 and 16-bit counting sorts and the parallel sort.  Dense keys
+  // are written straight from the counts, sparse ones staged and scattered.
+  std::vector<int8_t> chars = RandomValues<int8_t>(5000, ~0ULL);
+  sort_->Sort(chars);
+  EXPECT_EQ(1, stats_.passes);
+  EXPECT_EQ(5000 * sizeof(int8_t), stats_.bytes_moved);
+  stats_.Reset();
+  std::vector<int16_t> shorts = RandomValues<int16_t>(5000, ~0ULL);
+  sort_->Sort(shorts);
+  EXPECT_EQ(1, stats_.passes);
+  EXPECT_EQ(2 * 5000 * sizeof(int16_t), stats_.bytes_moved);
+  stats_.Reset();
+  sort_->set_num_threads(2);
+  std::vector<uint64_t> longs = RandomValues<uint64_t>(1 << 18, ~0ULL);
+  sort_->Sort(longs);
+  EXPECT_EQ(6, stats_.passes + stats_.passes_skipped);
+  EXPECT_LT(0, stats_.seconds[SCATTER_PHASE]);
+}
+
+TEST_F(SortStatsTest, TestHardwareCounters) {
+  // Tests that the counters count where perf_event_open is allowed.
+  if (!stats_.EnableHardwareCounters()) {
+    EXPECT_FALSE(stats_.hardware_counters());
+    return;
+  }
+  EXPECT_TRUE(stats_.hardware_counters());
+  std::vector<uint64_t> values = RandomValues<uint64_t>(1 << 20, ~0ULL);
+  sort_->Sort(values);
+  uint64_t misses = 0;
+  for (int phase = 0; phase < NUM_SORT_PHASES; ++phase) {
+    misses += stats_.cache_misses[phase];
+  }
+  EXPECT_LT(0, misses);
+}
+
+TEST_F(SortStatsTest, TestDetached) {
+  // Tests that sorts without stats leave them alone.
+  sort_->set_stats(nullptr);
+  std::vector<uint32_t> values = RandomValues<uint32_t>(1000, ~0ULL);
+  sort_->Sort(values);
+  EXPECT_EQ(0, stats_.sorts);
+  EXPECT_EQ(0, stats_.bytes_moved);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,353 @@
+// Copyright 2015 Kevin Melkowski
+
+#ifndef STREAMING_SORT_H_
+#define STREAMING_SORT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <mutex>  // NOLINT
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "sort/radix_sort/radix_sort.h"
+
+// Defaults, see set_max_runs and set_memory_limit.
+const int kDefaultMaxRuns = 8;
+const size_t kDefaultStreamingMemoryLimit = size_t(1) << 30;
+
+// Adjacent runs merged together by one background merge.
+const int kRunsPerMerge = 4;
+
+// Keeps keys that arrive in batches sorted.  Each batch is radix sorted into
+// a run, and once there are more than max_runs runs the cheapest adjacent
+// ones are merged on a background thread while batches keep coming.  Sorted
+// merges whatever runs are left, split across threads by key range, so a
+// sorted view costs a merge of a few runs rather than a sort of everything.
+// Add, Sorted and Clear should be called from one thread.
+template <typename T>
+class StreamingSort {
+ public:
+  StreamingSort();
+
+  // Merge with num_threads threads, 0 means one per hardware core.
+  explicit StreamingSort(const int num_threads);
+  ~StreamingSort();
+
+  // Sort a batch into a new run.  Returns false and drops the batch if the
+  // keys held would go past the memory limit.
+  bool Add(const T* batch, const int size);
+  bool Add(const std::vector<T>& batch);
+
+  // Every key added so far, in order.  The runs are merged into one, the
+  // reference stays valid until the next Add or Clear.
+  const std::vector<T>& Sorted();
+
+  // Drop every key.
+  void Clear();
+
+  // Wait for background merging to finish.
+  void WaitForMerges();
+
+  // Keys and runs held.
+  size_t size() const;
+  int runs() const;
+
+  // Background merges done since construction.
+  int background_merges() const;
+
+  // Runs kept before merging starts in the background.
+  int max_runs() const { return max_runs_; }
+  void set_max_runs(const int runs) { max_runs_ = std::max(1, runs); }
+
+  // Bytes of keys held, including the output of a background merge.  The
+  // final merge in Sorted needs room for one more copy of the keys.
+  size_t memory_limit() const { return memory_limit_; }
+  void set_memory_limit(const size_t bytes) { memory_limit_ = bytes; }
+
+  // Sorter used for the batches.  Its order also orders the merges.
+  RadixSort* sorter() { return &sorter_; }
+
+ private:
+  typedef UnsignedBits<T> Key;
+  typedef std::pair<const T*, const T*> Span;
+
+  // Start a background merge if there are too many runs, with the lock held.
+  void StartMerge();
+
+  // Background thread, merges until there are at most max_runs runs.
+  void MergeInBackground();
+
+  // Merge the sorted spans into output, split into key ranges across
+  // threads.
+  void MergeSpans(const std::vector<Span>& spans, T* output) const;
+
+  // Merge the spans on one thread.
+  void MergePartition(const std::vector<Span>& spans, T* output) const;
+
+  RadixSort sorter_;
+  int num_threads_;
+  int max_runs_;
+  size_t memory_limit_;
+
+  // Guards everything below.
+  mutable std::mutex mutex_;
+  std::vector<std::vector<T>> runs_;
+  size_t held_;
+  bool merging_;
+  int background_merges_;
+  std::thread merger_;
+};
+
+template <typename T>
+StreamingSort<T>::StreamingSort() : StreamingSort(1) {}
+
+template <typename T>
+StreamingSort<T>::StreamingSort(const int num_threads)
+    : num_threads_(num_threads),
+      max_runs_(kDefaultMaxRuns),
+      memory_limit_(kDefaultStreamingMemoryLimit),
+      held_(0),
+      merging_(false),
+      background_merges_(0) {
+  static_assert(std::is_arithmetic<T>::value && sizeof(T) <= 8,
+                "StreamingSort sorts integer and floating point keys");
+  if (num_threads_ <= 0) {  // hardware_concurrency may also return 0.
+    num_threads_ = std::max<int>(1, std::thread::hardware_concurrency());
+  }
+}
+
+template <typename T>
+StreamingSort<T>::~StreamingSort() {
+  WaitForMerges();
+}
+
+template <typename T>
+bool StreamingSort<T>::Add(const T* batch, const int size) {
+  if (size <= 0) {
+    return size == 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if ((held_ + size) * sizeof(T) > memory_limit_) {
+      return false;
+    }
+    held_ += size;
+  }
+  // Sort outside the lock so a background merge can run meanwhile.
+  std::vector<T> run(batch, batch + size);
+  sorter_.Sort(run);
+  std::lock_guard<std::mutex> lock(mutex_);
+  runs_.push_back(std::move(run));
+  StartMerge();
+  return true;
+}
+
+template <typename T>
+bool StreamingSort<T>::Add(const std::vector<T>& batch) {
+  return Add(batch.data(), batch.size());
+}
+
+template <typename T>
+const std::vector<T>& StreamingSort<T>::Sorted() {
+  WaitForMerges();
+  if (runs_.size() > 1) {
+    std::vector<Span> spans;
+    size_t total = 0;
+    for (const std::vector<T>& run : runs_) {
+      spans.emplace_back(run.data(), run.data() + run.size());
+      total += run.size();
+    }
+    std::vector<T> merged(total);
+    MergeSpans(spans, merged.data());
+    runs_.clear();
+    runs_.push_back(std::move(merged));
+  } else if (runs_.empty()) {
+    runs_.emplace_back();
+  }
+  return runs_.front();
+}
+
+template <typename T>
+void StreamingSort<T>::Clear() {
+  WaitForMerges();
+  runs_.clear();
+  held_ = 0;
+}
+
+template <typename T>
+void StreamingSort<T>::WaitForMerges() {
+  // Only the calling thread starts merges, so nothing new starts meanwhile.
+  if (merger_.joinable()) {
+    merger_.join();
+  }
+}
+
+template <typename T>
+size_t StreamingSort<T>::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t keys = 0;
+  for (const std::vector<T>& run : runs_) {
+    keys += run.size();
+  }
+  return keys;
+}
+
+template <typename T>
+int StreamingSort<T>::runs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return runs_.size();
+}
+
+template <typename T>
+int StreamingSort<T>::background_merges() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return background_merges_;
+}
+
+template <typename T>
+void StreamingSort<T>::StartMerge() {
+  if (merging_ || static_cast<int>(runs_.size()) <= max_runs_) {
+    return;
+  }
+  if (merger_.joinable()) {  // Finished, it only exits after merging_ is set.
+    merger_.join();
+  }
+  merging_ = true;
+  merger_ = std::thread(&StreamingSort::MergeInBackground, this);
+}
+
+template <typename T>
+void StreamingSort<T>::MergeInBackground() {
+  // Runs are only appended while this runs, so the chosen indices and the
+  // runs' data stay put while the lock is released.
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (static_cast<int>(runs_.size()) > max_runs_) {
+    // The adjacent runs with the fewest keys, merging neighbours keeps runs
+    // of similar sizes together.
+    const int count = std::min<int>(kRunsPerMerge, runs_.size());
+    size_t total = 0;
+    for (int i = 0; i < count; ++i) {
+      total += runs_[i].size();
+    }
+    size_t best_total = total;
+    int first = 0;
+    for (size_t i = count; i < runs_.size(); ++i) {
+      total += runs_[i].size() - runs_[i - count].size();
+      if (total < best_total) {
+        best_total = total;
+        first = i - count + 1;
+      }
+    }
+    if ((held_ + best_total) * sizeof(T) > memory_limit_) {
+      break;  // Sorted merges them later.
+    }
+    std::vector<Span> spans;
+    for (int i = first; i < first + count; ++i) {
+      spans.emplace_back(runs_[i].data(), runs_[i].data() + runs_[i].size());
+    }
+    held_ += best_total;
+    lock.unlock();
+
+    std::vector<T> merged(best_total);
+    MergeSpans(spans, merged.data());
+
+    lock.lock();
+    runs_[first] = std::move(merged);
+    runs_.erase(runs_.begin() + first + 1, runs_.begin() + first + count);
+    held_ -= best_total;
+    ++background_merges_;
+  }
+  merging_ = false;
+}
+
+template <typename T>
+void StreamingSort<T>::MergeSpans(const std::vector<Span>& spans,
+                                  T* output) const {
+  // Split every span at the same keys, sampled from the largest span, so
+  // each thread merges its own key range into its own part of the output.
+  size_t total = 0;
+  size_t largest = 0;
+  for (size_t i = 0; i < spans.size(); ++i) {
+    total += spans[i].second - spans[i].first;
+    if (spans[i].second - spans[i].first >
+        spans[largest].second - spans[largest].first) {
+      largest = i;
+    }
+  }
+  const int threads = std::max<int>(
+      1, std::min<size_t>(num_threads_, total / kMinElementsPerThread));
+  if (threads == 1) {
+    MergePartition(spans, output);
+    return;
+  }
+  const SortOrder order = sorter_.order();
+  auto less = [order](const T value, const Key key) {
+    return OrderedBits(value, order) < key;
+  };
+  const size_t largest_size = spans[largest].second - spans[largest].first;
+  std::vector<std::vector<Span>> partitions(threads, spans);
+  std::vector<T*> outputs(threads, output);
+  for (int thread = 1; thread < threads; ++thread) {
+    const Key splitter = OrderedBits(
+        spans[largest].first[largest_size * thread / threads], order);
+    size_t offset = 0;
+    for (size_t i = 0; i < spans.size(); ++i) {
+      const T* cut = std::lower_bound(partitions[thread - 1][i].first,
+                                      spans[i].second, splitter, less);
+      partitions[thread - 1][i].second = cut;
+      partitions[thread][i].first = cut;
+      offset += cut - spans[i].first;
+    }
+    outputs[thread] = output + offset;
+  }
+  std::vector<std::thread> workers;
+  for (int thread = 1; thread < threads; ++thread) {
+    workers.emplace_back(&StreamingSort::MergePartition, this,
+                         std::cref(partitions[thread]), outputs[thread]);
+  }
+  MergePartition(partitions[0], outputs[0]);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+template <typename T>
+void StreamingSort<T>::MergePartition(const std::vector<Span>& spans,
+                                      T* output) const {
+  const SortOrder order = sorter_.order();
+  if (spans.size() == 2) {
+    std::merge(spans[0].first, spans[0].second, spans[1].first,
+               spans[1].second, output, [order](const T a, const T b) {
+                 return OrderedBits(a, order) < OrderedBits(b, order);
+               });
+    return;
+  }
+
+  // Min heap of (key, span) pairs, ties go to the earlier span.
+  std::vector<std::pair<Key, int>> heap;
+  std::vector<Span> cursors(spans);
+  for (size_t i = 0; i < cursors.size(); ++i) {
+    if (cursors[i].first != cursors[i].second) {
+      heap.emplace_back(OrderedBits(*cursors[i].first, order), i);
+    }
+  }
+  auto greater = [](const std::pair<Key, int>& a,
+                    const std::pair<Key, int>& b) { return a > b; };
+  std::make_heap(heap.begin(), heap.end(), greater);
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    Span& cursor = cursors[heap.back().second];
+    *output++ = *cursor.first++;
+    if (cursor.first != cursor.second) {
+      heap.back().first = OrderedBits(*cursor.first, order);
+      std::push_heap(heap.begin(), heap.end(), greater);
+    } else {
+      heap.pop_back();
+    }
+  }
+}
+
+#endif  // STREAMING_SORT_H_
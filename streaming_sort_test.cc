@@ -0,0 +1,129 @@
+// Copyright 2015 Kevin Melkowski
+
+#include "sort/radix_sort/streaming_sort.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class StreamingSortTest : public ::testing::Test {
+ protected:
+  template <typename T>
+  std::vector<T> RandomBatch(const int size) {
+    std::vector<T> batch(size);
+    for (int i = 0; i < size; ++i) {
+      batch[i] = static_cast<T>(generator_());
+    }
+    return batch;
+  }
+
+  std::mt19937_64 generator_;
+};
+
+TEST_F(StreamingSortTest, TestEmpty) {
+  // Tests that nothing added sorts to nothing.
+  StreamingSort<uint32_t> sorter;
+  EXPECT_TRUE(sorter.Add(std::vector<uint32_t>()));
+  EXPECT_TRUE(sorter.Sorted().empty());
+  EXPECT_EQ(0, sorter.size());
+}
+
+TEST_F(StreamingSortTest, TestBatches) {
+  // Tests that sorted views in between batches hold every key so far.
+  StreamingSort<int64_t> sorter;
+  sorter.set_max_runs(3);
+  std::vector<int64_t> expected;
+  for (int batch = 0; batch < 20; ++batch) {
+    std::vector<int64_t> values = RandomBatch<int64_t>(1000 + batch * 37);
+    EXPECT_TRUE(sorter.Add(values));
+    expected.insert(expected.end(), values.begin(), values.end());
+    if (batch % 7 == 6) {
+      std::sort(expected.begin(), expected.end());
+      EXPECT_EQ(expected, sorter.Sorted());
+      EXPECT_EQ(1, sorter.runs());
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, sorter.Sorted());
+  EXPECT_EQ(expected.size(), sorter.size());
+}
+
+TEST_F(StreamingSortTest, TestBackgroundMerges) {
+  // Tests that runs past max_runs are merged in the background.
+  StreamingSort<uint64_t> sorter;
+  sorter.set_max_runs(4);
+  std::vector<uint64_t> expected;
+  for (int batch = 0; batch < 30; ++batch) {
+    std::vector<uint64_t> values = RandomBatch<uint64_t>(5000);
+    EXPECT_TRUE(sorter.Add(values));
+    expected.insert(expected.end(), values.begin(), values.end());
+  }
+  sorter.WaitForMerges();
+  EXPECT_LE(sorter.runs(), 4);
+  EXPECT_LT(0, sorter.background_merges());
+  EXPECT_EQ(expected.size(), sorter.size());
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, sorter.Sorted());
+}
+
+TEST_F(StreamingSortTest, TestParallelMerge) {
+  // Tests splitting the merge of floats across threads.
+  StreamingSort<float> sorter(4);
+  std::uniform_real_distribution<float> distribution(-1e6, 1e6);
+  std::vector<float> expected;
+  for (int batch = 0; batch < 6; ++batch) {
+    std::vector<float> values(100000 + batch * 1000);
+    for (float& value : values) {
+      value = distribution(generator_);
+    }
+    EXPECT_TRUE(sorter.Add(values));
+    expected.insert(expected.end(), values.begin(), values.end());
+  }
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, sorter.Sorted());
+}
+
+TEST_F(StreamingSortTest, TestDescending) {
+  // Tests that merges follow the sorter's order.
+  StreamingSort<int16_t> sorter(2);
+  sorter.sorter()->set_order(DESCENDING);
+  sorter.set_max_runs(2);
+  std::vector<int16_t> expected;
+  for (int batch = 0; batch < 10; ++batch) {
+    std::vector<int16_t> values = RandomBatch<int16_t>(777);
+    EXPECT_TRUE(sorter.Add(values));
+    expected.insert(expected.end(), values.begin(), values.end());
+  }
+  std::sort(expected.rbegin(), expected.rend());
+  EXPECT_EQ(expected, sorter.Sorted());
+}
+
+TEST_F(StreamingSortTest, TestMemoryLimit) {
+  // Tests that batches past the memory limit are dropped.
+  StreamingSort<uint32_t> sorter;
+  sorter.set_memory_limit(1000 * sizeof(uint32_t));
+  EXPECT_TRUE(sorter.Add(RandomBatch<uint32_t>(600)));
+  EXPECT_FALSE(sorter.Add(RandomBatch<uint32_t>(600)));
+  EXPECT_TRUE(sorter.Add(RandomBatch<uint32_t>(400)));
+  EXPECT_EQ(1000, sorter.Sorted().size());
+  sorter.Clear();
+  EXPECT_EQ(0, sorter.size());
+  EXPECT_TRUE(sorter.Add(RandomBatch<uint32_t>(600)));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  return RUN_ALL_TESTS();
+}